@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include <vector>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+
+namespace arith {
+
+// Bump allocator, which places objects of different types back to back in one block of fixed capacity.
+// The capacity has to be reserved before the first allocation, bytes() gives an upper bound for an array of T.
+// The objects are destroyed in reverse order of their construction together with the arena.
+struct Arena {
+	static const size_t ALIGN = 64;
+
+	struct Dtor {
+		void *p;
+		size_t n;
+		void (*fn)(void*, size_t);
+	};
+
+	uint8_t *mem, *begin, *cur, *end;
+	std::vector<Dtor> dtors;
+
+	Arena() : mem(NULL), begin(NULL), cur(NULL), end(NULL)
+	{}
+
+	Arena(const Arena&) = delete;
+	Arena &operator=(const Arena&) = delete;
+
+	~Arena()
+	{
+		for (int i = dtors.size() - 1; i >= 0; --i) {
+			dtors[i].fn(dtors[i].p, dtors[i].n);
+		}
+		delete[] mem;
+	}
+
+	void reserve(size_t cap)
+	{
+		if (mem != NULL) throw std::runtime_error("Arena already in use");
+		mem = new uint8_t[cap + ALIGN];
+		begin = cur = mem + (ALIGN - (uintptr_t)mem % ALIGN) % ALIGN;
+		end = begin + cap;
+	}
+
+	template <typename T>
+	static size_t bytes(size_t n = 1)
+	{
+		return sizeof(T) * n + alignof(T) - 1;
+	}
+
+	size_t capacity() const
+	{
+		return end - begin;
+	}
+	size_t used() const
+	{
+		return cur - begin;
+	}
+
+	template <typename T, typename... A>
+	T *make(A&&... args)
+	{
+		T *p = new (alloc<T>(1)) T(std::forward<A>(args)...);
+		destroy_later(p, 1);
+		return p;
+	}
+
+	// default-constructed array of n elements
+	template <typename T>
+	T *make_array(size_t n)
+	{
+		T *p = (T*)alloc<T>(n);
+		for (size_t i = 0; i < n; ++i) {
+			new (p + i) T();
+		}
+		destroy_later(p, n);
+		return p;
+	}
+
+private:
+	template <typename T>
+	void *alloc(size_t n)
+	{
+		uint8_t *p = cur + (alignof(T) - (uintptr_t)cur % alignof(T)) % alignof(T);
+		if (p + sizeof(T) * n > end) throw std::runtime_error("Arena exhausted");
+		cur = p + sizeof(T) * n;
+		return p;
+	}
+
+	template <typename T>
+	static void destroy(void *p, size_t n)
+	{
+		for (size_t i = 0; i < n; ++i) {
+			((T*)p)[i].~T();
+		}
+	}
+
+	template <typename T>
+	void destroy_later(T *p, size_t n)
+	{
+		if (std::is_trivially_destructible<T>::value) return;
+		dtors.push_back(Dtor{ p, n, &destroy<T> });
+	}
+};
+
+}
@@ -8,35 +8,152 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <vector>
 #include <istream>
 #include <ostream>
 
 namespace arith {
 
+// Byte stream over a contiguous memory buffer. Reads beyond the end yield zeros.
+// When constructed from a std::istream, the remainder of that stream is read into memory at once.
+struct memistream {
+	std::vector<uint8_t> own;
+	const uint8_t *cur, *end;
+
+	memistream(const uint8_t *_begin, const uint8_t *_end) : cur(_begin), end(_end)
+	{}
+	memistream(std::istream &is)
+	{
+		std::size_t n = 0, chunk = 1 << 16;
+		while (is) {
+			own.resize(n + chunk);
+			is.read((char*)own.data() + n, chunk);
+			n += is.gcount();
+			chunk = n;
+		}
+		own.resize(n);
+		cur = own.data();
+		end = cur + n;
+	}
+
+	memistream(const memistream&) = delete;
+	memistream &operator=(const memistream&) = delete;
+
+	uint8_t get()
+	{
+		return cur < end ? *cur++ : 0;
+	}
+	uint32_t get_le32()
+	{
+		uint32_t w = 0;
+		if (end - cur < 4) {
+			for (int i = 0; i < 4; ++i) w |= uint32_t(get()) << (8 * i);
+			return w;
+		}
+		w = uint32_t(cur[0]) | uint32_t(cur[1]) << 8 | uint32_t(cur[2]) << 16 | uint32_t(cur[3]) << 24;
+		cur += 4;
+		return w;
+	}
+	uint64_t get_le64()
+	{
+		uint64_t lo = get_le32();
+		return lo | uint64_t(get_le32()) << 32;
+	}
+	uint64_t get_be64()
+	{
+		uint64_t w = 0;
+		if (end - cur < 8) {
+			for (int i = 0; i < 8; ++i) w = w << 8 | get();
+			return w;
+		}
+		for (int i = 0; i < 8; ++i) w = w << 8 | cur[i];
+		cur += 8;
+		return w;
+	}
+};
+
+// Byte stream into a std::vector. When constructed from a std::ostream, the data is kept in memory and written
+// to that stream on flush.
+struct memostream {
+	std::vector<uint8_t> own;
+	std::vector<uint8_t> &buf;
+	std::ostream *os;
+
+	memostream(std::vector<uint8_t> &_buf) : buf(_buf), os(NULL)
+	{}
+	memostream(std::ostream &_os) : buf(own), os(&_os)
+	{}
+
+	memostream(const memostream&) = delete;
+	memostream &operator=(const memostream&) = delete;
+
+	void flush()
+	{
+		if (os == NULL) return;
+		os->write((const char*)buf.data(), buf.size());
+		buf.clear();
+		os->flush();
+	}
+
+	void put(uint8_t c)
+	{
+		buf.push_back(c);
+	}
+	void put_le32(uint32_t w)
+	{
+		std::size_t o = grow(4);
+		for (int i = 0; i < 4; ++i) buf[o + i] = w >> (8 * i);
+	}
+	void put_le64(uint64_t w)
+	{
+		std::size_t o = grow(8);
+		for (int i = 0; i < 8; ++i) buf[o + i] = w >> (8 * i);
+	}
+	void put_be64(uint64_t w)
+	{
+		std::size_t o = grow(8);
+		for (int i = 0; i < 8; ++i) buf[o + i] = w >> (56 - 8 * i);
+	}
+
+private:
+	std::size_t grow(std::size_t n)
+	{
+		std::size_t o = buf.size();
+		buf.resize(o + n);
+		return o;
+	}
+};
+
+// MSB-first bit streams, which move 64 bit words from and to memory.
 struct bitistream {
-	std::istream &is;
+	memistream is;
 	int idx;
-	unsigned char buf;
+	uint64_t buf;
 
-	bitistream(std::istream &_is) : is(_is), idx(8), buf(0)
+	template <typename T>
+	bitistream(T &_is) : is(_is), idx(64), buf(0)
+	{}
+	bitistream(const uint8_t *begin, const uint8_t *end) : is(begin, end), idx(64), buf(0)
 	{}
 
 	bitistream &operator>>(unsigned char &bit)
 	{
-		if (idx == 8) {
-			buf = is.get();
+		if (idx == 64) {
+			buf = is.get_be64();
 			idx = 0;
 		}
-		bit = (buf >> (7 - idx++)) & 1;
+		bit = (buf >> (63 - idx++)) & 1;
 		return *this;
 	}
 };
 struct bitostream {
-	std::ostream &os;
+	memostream os;
 	int idx;
-	unsigned char buf;
+	uint64_t buf;
 
-	bitostream(std::ostream &_os) : os(_os), idx(0), buf(0)
+	template <typename T>
+	bitostream(T &_os) : os(_os), idx(0), buf(0)
 	{}
 
 	~bitostream()
@@ -44,18 +161,22 @@ struct bitostream {
 		flush();
 	}
 
+	// pads the last byte with zeros
 	void flush()
 	{
-		if (idx == 0) return; // buffer already empty
-		os << buf;
+		for (int i = 0; i < idx; i += 8) {
+			os.put(buf >> (56 - i));
+		}
 		buf = 0; idx = 0; // clear and reset
+		os.flush();
 	}
 
 	bitostream &operator<<(unsigned char bit)
 	{
-		buf |= bit << (7 - idx);
-		if (++idx == 8) {
-			flush();
+		buf |= uint64_t(bit) << (63 - idx);
+		if (++idx == 64) {
+			os.put_be64(buf);
+			buf = 0; idx = 0;
 		}
 		return *this;
 	}
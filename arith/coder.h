@@ -19,11 +19,16 @@
 #include <algorithm>
 #include <istream>
 #include <ostream>
+#include <vector>
 
 #include "bitstream.h"
 
 namespace arith {
 
+// Entropy coder backend. ARITH is the bitwise coder of Moffat et al., RANGE renormalizes a byte at a time (see range.h),
+// RANS is an interleaved rANS coder with a cheaper decoder (see rans.h).
+enum Backend { ARITH, RANGE, RANS };
+
 template <typename TF = uint64_t>
 struct Coder {
 	typedef TF FreqType;
@@ -33,8 +38,13 @@ struct Coder {
 	static const TF QUARTER = TF(1) << (b - 2);
 };
 
-template <typename TF = uint64_t, typename TBO = uint64_t>
-struct Encoder : Coder<TF> {
+template <typename TF = uint64_t, Backend B = ARITH, typename TBO = uint64_t>
+struct Encoder;
+template <typename TF = uint64_t, Backend B = ARITH>
+struct Decoder;
+
+template <typename TF, typename TBO>
+struct Encoder<TF, ARITH, TBO> : Coder<TF> {
 	using Coder<TF>::b;
 	using Coder<TF>::HALF;
 	using Coder<TF>::QUARTER;
@@ -44,7 +54,9 @@ struct Encoder : Coder<TF> {
 	bitostream os;
 	bool flushed;
 
-	Encoder(std::ostream &_os) : os(_os), L(0), R(HALF), bits_outstanding(0), flushed(false)
+	Encoder(std::ostream &_os) : L(0), R(HALF), bits_outstanding(0), os(_os), flushed(false)
+	{}
+	Encoder(std::vector<uint8_t> &buf) : L(0), R(HALF), bits_outstanding(0), os(buf), flushed(false)
 	{}
 
 	~Encoder()
@@ -66,9 +78,10 @@ struct Encoder : Coder<TF> {
 		os.flush();
 	}
 
-	void operator()(TF l, TF h, TF t)
+	// shift != 0 states that t = 2^shift, the division is replaced by a shift then
+	void operator()(TF l, TF h, TF t, int shift = 0)
 	{
-		TF r = R / t;
+		TF r = shift ? R >> shift : R / t;
 		L = L + r * l;
 		if (h < t)
 			R = r * (h - l);
@@ -94,7 +107,7 @@ struct Encoder : Coder<TF> {
 	{
 		TF l, h, t = freq.total();
 		freq.range(s, l, h);
-		(*this)(l, h, t);
+		(*this)(l, h, t, S::SHIFT);
 	}
 
 private:
@@ -112,8 +125,8 @@ private:
 	}
 };
 
-template <typename TF = uint64_t>
-struct Decoder : Coder<TF> {
+template <typename TF>
+struct Decoder<TF, ARITH> : Coder<TF> {
 	using Coder<TF>::b;
 	using Coder<TF>::HALF;
 	using Coder<TF>::QUARTER;
@@ -121,25 +134,27 @@ struct Decoder : Coder<TF> {
 	TF R, D, r; // R = range
 	bitistream is;
 
-	Decoder(std::istream &_is) : is(_is), R(HALF), D(0)
+	Decoder(std::istream &_is) : R(HALF), D(0), is(_is)
 	{
-		for (int i = 0; i < b; ++i) {
-			D = 2 * D + read_one_bit();
-		}
+		init();
+	}
+	Decoder(const uint8_t *begin, const uint8_t *end) : R(HALF), D(0), is(begin, end)
+	{
+		init();
 	}
 
 	Decoder(const Decoder&) = delete;
 	Decoder &operator=(const Decoder&) = delete;
 
-	TF decode_target(TF t)
+	TF decode_target(TF t, int shift = 0)
 	{
-		r = R / t;
+		r = shift ? R >> shift : R / t;
 		return std::min(t - 1, D / r);
 	}
 
-	void operator()(TF l, TF h, TF t)
+	void operator()(TF l, TF h, TF t, int = 0)
 	{
-		// r already set by decode_target
+		// r already set by decode_target, which also handled the shift
 		D = D - r * l;
 		if (h < t)
 			R = r * (h - l);
@@ -155,7 +170,7 @@ struct Decoder : Coder<TF> {
 	typename S::SymType operator()(S &freq)
 	{
 		TF l, h, t = freq.total();
-		TF target = decode_target(t);
+		TF target = decode_target(t, S::SHIFT);
 		typename S::SymType s = freq.symbol(target, l, h);
 		(*this)(l, h, t);
 		return s;
@@ -163,6 +178,12 @@ struct Decoder : Coder<TF> {
 
 
 private:
+	void init()
+	{
+		for (int i = 0; i < b; ++i) {
+			D = 2 * D + read_one_bit();
+		}
+	}
 	unsigned char read_one_bit()
 	{
 		unsigned char bit;
@@ -8,31 +8,52 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include "coder.h"
+#include "range.h"
+#include "rans.h"
+#include "stat_bit.h"
 
 namespace arith {
 
-template <typename TF = uint64_t>
+// Base of all models. D is the derived model, whose enc() and dec() are called without virtual dispatch.
+template <typename D, typename TF = uint64_t, Backend B = ARITH>
 struct Model {
-	virtual void enc(Encoder<TF> &coder, const unsigned char *s, int n) = 0;
-	virtual void dec(Decoder<TF> &coder, unsigned char *s, int n) = 0;
-
 	template <typename T>
-	void encode(Encoder<TF> &coder, const T &s)
+	void encode(Encoder<TF, B> &coder, const T &s)
 	{
-		enc(coder, (const unsigned char*)&s, sizeof(T));
+		static_cast<D*>(this)->enc(coder, (const unsigned char*)&s, sizeof(T));
 	}
 	template <typename T>
-	T decode(Decoder<TF> &coder)
+	T decode(Decoder<TF, B> &coder)
 	{
 		T s;
-		dec(coder, (unsigned char*)&s, sizeof(T));
+		static_cast<D*>(this)->dec(coder, (unsigned char*)&s, sizeof(T));
 		return s;
 	}
 };
 
-template <typename T, typename S, typename TF = uint64_t>
-struct ModelMult : Model<TF> {
+// Codes the n bytes of s with one statistics module per byte
+template <typename S, typename TF, Backend B>
+void enc_bytes(Encoder<TF, B> &coder, S *stats, const unsigned char *s, int n)
+{
+	for (int i = 0; i < n; ++i) {
+		coder(stats[i], s[i]);
+		stats[i].inc(s[i]);
+	}
+}
+template <typename S, typename TF, Backend B>
+void dec_bytes(Decoder<TF, B> &coder, S *stats, unsigned char *s, int n)
+{
+	for (int i = 0; i < n; ++i) {
+		s[i] = coder(stats[i]);
+		stats[i].inc(s[i]);
+	}
+}
+
+template <typename T, typename S, typename TF = uint64_t, Backend B = ARITH>
+struct ModelMult : Model<ModelMult<T, S, TF, B>, TF, B> {
 	S stats[sizeof(T)];
 
 	ModelMult(bool init = true)
@@ -46,6 +67,9 @@ struct ModelMult : Model<TF> {
 		}
 	}
 
+	ModelMult(const ModelMult&) = delete;
+	ModelMult &operator=(const ModelMult&) = delete;
+
 	void init(T val)
 	{
 		const char *s = (const char*)&val;
@@ -54,26 +78,164 @@ struct ModelMult : Model<TF> {
 		}
 	}
 
-	void enc(Encoder<TF> &coder, const unsigned char *s, int n)
+	void enc(Encoder<TF, B> &coder, const unsigned char *s, int n)
 	{
 #ifdef HAVE_ASSERT
 		assert_eq(sizeof(T), n);
 #endif
-		for (int i = 0; i < sizeof(T); ++i) {
-			coder(this->stats[i], s[i]);
-			this->stats[i].inc(s[i]);
+		enc_bytes(coder, this->stats, s, sizeof(T));
+	}
+
+	void dec(Decoder<TF, B> &coder, unsigned char *s, int n)
+	{
+#ifdef HAVE_ASSERT
+		assert_eq(sizeof(T), n);
+#endif
+		dec_bytes(coder, this->stats, s, sizeof(T));
+	}
+};
+
+// Binary models of one byte, which is coded as 8 decisions along a bit tree like the literal coder of LZMA. Every decision
+// is conditioned on the already coded bits of its byte and on the bit length of the previously coded byte.
+struct BitTree {
+	static const int NCTX = 9;
+	BitStatisticsModule<> node[NCTX][256]; // node 0 is unused
+
+	static int bitlen(unsigned char c)
+	{
+		return c == 0 ? 0 : 32 - __builtin_clz(c);
+	}
+};
+
+// Codes the n bytes of s with one bit tree per byte. The bytes are coded from the highest address downwards (most
+// significant first on little-endian machines).
+template <typename TF, Backend B>
+void enc_bits(Encoder<TF, B> &coder, BitTree *trees, const unsigned char *s, int n)
+{
+	int ctx = 0;
+	for (int i = n - 1; i >= 0; --i) {
+		BitStatisticsModule<> *tree = trees[i].node[ctx];
+		unsigned int node = 1;
+		for (int k = 7; k >= 0; --k) {
+			unsigned int bit = (s[i] >> k) & 1;
+			coder(tree[node], bit);
+			tree[node].inc(bit);
+			node = node << 1 | bit;
 		}
+		ctx = BitTree::bitlen(s[i]);
 	}
+}
+template <typename TF, Backend B>
+void dec_bits(Decoder<TF, B> &coder, BitTree *trees, unsigned char *s, int n)
+{
+	int ctx = 0;
+	for (int i = n - 1; i >= 0; --i) {
+		BitStatisticsModule<> *tree = trees[i].node[ctx];
+		unsigned int node = 1;
+		for (int k = 7; k >= 0; --k) {
+			unsigned int bit = coder(tree[node]);
+			tree[node].inc(bit);
+			node = node << 1 | bit;
+		}
+		s[i] = node;
+		ctx = BitTree::bitlen(s[i]);
+	}
+}
 
-	void dec(Decoder<TF> &coder, unsigned char *s, int n)
+template <typename T, typename TF = uint64_t, Backend B = ARITH>
+struct ModelBits : Model<ModelBits<T, TF, B>, TF, B> {
+	BitTree stats[sizeof(T)];
+
+	void enc(Encoder<TF, B> &coder, const unsigned char *s, int n)
 	{
 #ifdef HAVE_ASSERT
 		assert_eq(sizeof(T), n);
 #endif
-		for (int i = 0; i < sizeof(T); ++i) {
-			s[i] = coder(this->stats[i]);
-			this->stats[i].inc(s[i]);
+		enc_bits(coder, this->stats, s, sizeof(T));
+	}
+
+	void dec(Decoder<TF, B> &coder, unsigned char *s, int n)
+	{
+#ifdef HAVE_ASSERT
+		assert_eq(sizeof(T), n);
+#endif
+		dec_bits(coder, this->stats, s, sizeof(T));
+	}
+};
+
+// Codes unsigned integers as their bit length (Elias-gamma bucket) with the adaptive statistics module S, which needs
+// sizeof(T) * 8 + 1 symbols. The ABITS bits below the leading one are coded with binary models per bucket, all lower bits
+// are written with equal probabilities. Therefore, small values cost one or two coder calls instead of one per byte.
+template <typename T, typename S, typename TF = uint64_t, Backend B = ARITH>
+struct ModelGamma : Model<ModelGamma<T, S, TF, B>, TF, B> {
+	static const int BITS = sizeof(T) * 8;
+	static const int ABITS = 2;
+	static const int RAWCHUNK = 16; // the raw bits are coded in chunks of at most 2^RAWCHUNK values
+	S bucket;
+	BitStatisticsModule<> mant[BITS + 1][1 << ABITS]; // node 0 is unused
+
+	ModelGamma() : bucket(BITS + 1)
+	{
+		for (int i = 0; i <= BITS; ++i) {
+			bucket.init(i);
+		}
+	}
+
+	void enc(Encoder<TF, B> &coder, const unsigned char *s, int n)
+	{
+#ifdef HAVE_ASSERT
+		assert_eq(sizeof(T), n);
+#endif
+		T v = *(const T*)s;
+		int k = v == 0 ? 0 : 64 - __builtin_clzll(v);
+		coder(bucket, k);
+		bucket.inc(k);
+		if (k <= 1) return;
+
+		int m = k - 1, a = std::min(m, ABITS);
+		unsigned int node = 1;
+		for (int j = m - 1; j >= m - a; --j) {
+			unsigned int bit = (v >> j) & 1;
+			coder(mant[k][node], bit);
+			mant[k][node].inc(bit);
+			node = node << 1 | bit;
+		}
+		for (int r = m - a; r > 0;) {
+			int c = std::min(r, RAWCHUNK);
+			r -= c;
+			TF x = (v >> r) & ((TF(1) << c) - 1);
+			coder(x, x + 1, TF(1) << c, c);
+		}
+	}
+
+	void dec(Decoder<TF, B> &coder, unsigned char *s, int n)
+	{
+#ifdef HAVE_ASSERT
+		assert_eq(sizeof(T), n);
+#endif
+		int k = coder(bucket);
+		bucket.inc(k);
+		if (k <= 1) {
+			*(T*)s = k;
+			return;
+		}
+
+		int m = k - 1, a = std::min(m, ABITS);
+		unsigned int node = 1;
+		for (int j = 0; j < a; ++j) {
+			unsigned int bit = coder(mant[k][node]);
+			mant[k][node].inc(bit);
+			node = node << 1 | bit;
+		}
+		T v = node;
+		for (int r = m - a; r > 0;) {
+			int c = std::min(r, RAWCHUNK);
+			r -= c;
+			TF t = TF(1) << c, x = coder.decode_target(t, c);
+			coder(x, x + 1, t, c);
+			v = v << c | x;
 		}
+		*(T*)s = v;
 	}
 };
 
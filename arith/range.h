@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+/*
+ * Implementation of a Range Coder with byte-wise renormalization and carry propagation.
+ *
+ * Related publications:
+ * Martin, G. Nigel N. "Range encoding: an algorithm for removing redundancy from a digitised message." Video and Data Recording Conference, Southampton, 1979.
+ * Schindler, Michael. "A fast renormalisation for arithmetic coding." Proceedings of the Data Compression Conference. IEEE, 1998.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "coder.h"
+#include "bitstream.h"
+
+namespace arith {
+
+// The low value keeps CARRY bits plus one carry bit, the range is renormalized as soon as it drops below BOT.
+// Frequency totals must not exceed BOT.
+template <typename TF>
+struct RangeCoder : Coder<TF> {
+	using Coder<TF>::b;
+
+	static const int CARRY = b - 8;
+	static const TF TOP = TF(1) << CARRY;
+	static const TF BOT = TF(1) << (CARRY - 8);
+};
+
+template <typename TF, typename TBO>
+struct Encoder<TF, RANGE, TBO> : RangeCoder<TF> {
+	using RangeCoder<TF>::CARRY;
+	using RangeCoder<TF>::TOP;
+	using RangeCoder<TF>::BOT;
+
+	TF L, R; // L = low, R = range
+	unsigned char cache; // last byte, which may still be changed by a carry
+	TBO cache_size; // number of pending bytes (cache followed by 0xff bytes)
+	memostream os;
+	bool flushed;
+
+	Encoder(std::ostream &_os) : L(0), R(TOP - 1), cache(0), cache_size(1), os(_os), flushed(false)
+	{}
+	Encoder(std::vector<uint8_t> &buf) : L(0), R(TOP - 1), cache(0), cache_size(1), os(buf), flushed(false)
+	{}
+
+	~Encoder()
+	{
+		flush();
+	}
+
+	Encoder(const Encoder&) = delete;
+	Encoder &operator=(const Encoder&) = delete;
+
+	void flush()
+	{
+		if (flushed) return;
+		flushed = true;
+
+		for (unsigned int i = 0; i < sizeof(TF); ++i) {
+			shift_low();
+		}
+		os.flush();
+	}
+
+	// shift != 0 states that t = 2^shift, the division is replaced by a shift then
+	void operator()(TF l, TF h, TF t, int shift = 0)
+	{
+		TF r = shift ? R >> shift : R / t;
+		L = L + r * l;
+		if (h < t)
+			R = r * (h - l);
+		else
+			R = R - r * l;
+
+		while (R < BOT) {
+			R <<= 8;
+			shift_low();
+		}
+	}
+	template <typename S>
+	void operator()(S &freq, typename S::SymType s)
+	{
+		TF l, h, t = freq.total();
+		freq.range(s, l, h);
+		(*this)(l, h, t, S::SHIFT);
+	}
+
+private:
+	void shift_low()
+	{
+		if (L < (TF(0xff) << (CARRY - 8)) || L >= TOP) {
+			unsigned char carry = L >> CARRY;
+			unsigned char tmp = cache;
+			do {
+				os.put(tmp + carry);
+				tmp = 0xff;
+			} while (--cache_size != 0);
+			cache = L >> (CARRY - 8);
+		}
+		++cache_size;
+		L = (L << 8) & (TOP - 1);
+	}
+};
+
+template <typename TF>
+struct Decoder<TF, RANGE> : RangeCoder<TF> {
+	using RangeCoder<TF>::TOP;
+	using RangeCoder<TF>::BOT;
+
+	TF R, D, r; // R = range, D = code - low
+	memistream is;
+
+	Decoder(std::istream &_is) : R(TOP - 1), D(0), is(_is)
+	{
+		init();
+	}
+	Decoder(const uint8_t *begin, const uint8_t *end) : R(TOP - 1), D(0), is(begin, end)
+	{
+		init();
+	}
+
+	Decoder(const Decoder&) = delete;
+	Decoder &operator=(const Decoder&) = delete;
+
+	TF decode_target(TF t, int shift = 0)
+	{
+		r = shift ? R >> shift : R / t;
+		return std::min(t - 1, D / r);
+	}
+
+	void operator()(TF l, TF h, TF t, int = 0)
+	{
+		// r already set by decode_target, which also handled the shift
+		D = D - r * l;
+		if (h < t)
+			R = r * (h - l);
+		else
+			R = R - r * l;
+
+		while (R < BOT) {
+			R <<= 8;
+			D = (D << 8) | read_byte();
+		}
+	}
+	template <typename S>
+	typename S::SymType operator()(S &freq)
+	{
+		TF l, h, t = freq.total();
+		TF target = decode_target(t, S::SHIFT);
+		typename S::SymType s = freq.symbol(target, l, h);
+		(*this)(l, h, t);
+		return s;
+	}
+
+private:
+	void init()
+	{
+		for (unsigned int i = 0; i < sizeof(TF); ++i) {
+			D = (D << 8) | read_byte();
+		}
+	}
+	unsigned char read_byte()
+	{
+		return is.get();
+	}
+};
+
+}
@@ -0,0 +1,201 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+/*
+ * Implementation of an interleaved range Asymmetric Numeral Systems (rANS) coder.
+ *
+ * Related publications:
+ * Duda, Jarek. "Asymmetric numeral systems: entropy coding combining speed of Huffman coding with compression rate of arithmetic coding." arXiv preprint arXiv:1311.2540 (2013).
+ * Giesen, Fabian. "Interleaved entropy coders." arXiv preprint arXiv:1402.3392 (2014).
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include <istream>
+#include <ostream>
+
+#include "coder.h"
+#include "bitstream.h"
+#ifdef HAVE_ASSERT
+#include "utils/assert.h"
+#endif
+
+namespace arith {
+
+// rANS is LIFO, while adaptive models have to be updated in stream order. Therefore, the encoder
+// buffers BLOCK symbols and codes them in reverse. Each block starts with the final states of the
+// LANES interleaved coders followed by the renormalization words in decoding order.
+// Consecutive symbols are assigned to the lanes round robin, which breaks the dependency chain of
+// the state updates in the decoder.
+// The frequency totals are mapped onto M = 2^SCALE, so they must not exceed M. Adaptive statistics modules grow beyond M on
+// large meshes, their counts are halved before a symbol is coded (see bound()).
+template <typename TF>
+struct RansCoder {
+	typedef TF FreqType;
+
+	static const int LANES = 4; // part of the stream format, 4 to 8 work well
+	static const int BLOCK = 1 << 16;
+
+	static const int SCALE = 31;
+	static const uint64_t M = uint64_t(1) << SCALE;
+	static const uint64_t L = uint64_t(1) << 31; // states are kept in [L, L << 32)
+
+	// maps a cumulative frequency of total t onto [0, M], shift != 0 states that t = 2^shift
+	static uint64_t scale(TF c, TF t, int shift)
+	{
+		return shift ? uint64_t(c) << (SCALE - shift) : (uint64_t(c) << SCALE) / t;
+	}
+
+	// Halves the counts of freq until its total fits into M. Encoder and decoder see the same counts at this point, so
+	// both halve alike. Modules without halve() have fixed totals, which fit.
+	template <typename S>
+	static auto bound(S &freq, int) -> decltype(freq.halve(), void())
+	{
+		while (freq.total() > M) freq.halve();
+	}
+	template <typename S>
+	static void bound(S&, long)
+	{}
+};
+
+template <typename TF, typename TBO>
+struct Encoder<TF, RANS, TBO> : RansCoder<TF> {
+	typedef RansCoder<TF> C;
+
+	struct sym {
+		uint32_t start, freq;
+	};
+
+	std::vector<sym> buf;
+	std::vector<uint32_t> words;
+	memostream os;
+	bool flushed;
+
+	Encoder(std::ostream &_os) : os(_os), flushed(false)
+	{
+		buf.reserve(C::BLOCK);
+	}
+	Encoder(std::vector<uint8_t> &_buf) : os(_buf), flushed(false)
+	{
+		buf.reserve(C::BLOCK);
+	}
+
+	~Encoder()
+	{
+		flush();
+	}
+
+	Encoder(const Encoder&) = delete;
+	Encoder &operator=(const Encoder&) = delete;
+
+	void flush()
+	{
+		if (flushed) return;
+		flushed = true;
+
+		if (!buf.empty()) encode_block();
+		os.flush();
+	}
+
+	void operator()(TF l, TF h, TF t, int shift = 0)
+	{
+#ifdef HAVE_ASSERT
+		assert_le(t, C::M);
+#endif
+		uint64_t sl = C::scale(l, t, shift), sh = h < t ? C::scale(h, t, shift) : C::M;
+		buf.push_back(sym{ uint32_t(sl), uint32_t(sh - sl) });
+		if (buf.size() == C::BLOCK) encode_block();
+	}
+	template <typename S>
+	void operator()(S &freq, typename S::SymType s)
+	{
+		C::bound(freq, 0);
+		TF l, h, t = freq.total();
+		freq.range(s, l, h);
+		(*this)(l, h, t, S::SHIFT);
+	}
+
+private:
+	void encode_block()
+	{
+		uint64_t x[C::LANES];
+		for (int i = 0; i < C::LANES; ++i) x[i] = C::L;
+
+		words.clear();
+		for (int i = buf.size() - 1; i >= 0; --i) {
+			uint64_t &xi = x[i % C::LANES];
+			const sym &s = buf[i];
+			uint64_t x_max = ((C::L >> C::SCALE) << 32) * s.freq;
+			if (xi >= x_max) {
+				words.push_back(uint32_t(xi));
+				xi >>= 32;
+			}
+			xi = ((xi / s.freq) << C::SCALE) + (xi % s.freq) + s.start;
+		}
+
+		for (int i = 0; i < C::LANES; ++i) os.put_le64(x[i]);
+		for (int i = words.size() - 1; i >= 0; --i) os.put_le32(words[i]);
+		buf.clear();
+	}
+};
+
+template <typename TF>
+struct Decoder<TF, RANS> : RansCoder<TF> {
+	typedef RansCoder<TF> C;
+
+	uint64_t x[C::LANES];
+	int lane, left;
+	uint64_t y; // scaled target of the current lane
+	memistream is;
+
+	Decoder(std::istream &_is) : lane(0), left(0), is(_is)
+	{}
+	Decoder(const uint8_t *begin, const uint8_t *end) : lane(0), left(0), is(begin, end)
+	{}
+
+	Decoder(const Decoder&) = delete;
+	Decoder &operator=(const Decoder&) = delete;
+
+	TF decode_target(TF t, int shift = 0)
+	{
+		if (left == 0) { // block start
+			for (int i = 0; i < C::LANES; ++i) x[i] = is.get_le64();
+			lane = 0;
+			left = C::BLOCK;
+		}
+		y = x[lane] & (C::M - 1);
+		if (shift) return y >> (C::SCALE - shift);
+		return ((y + 1) * t - 1) >> C::SCALE; // largest c with scale(c, t) <= y
+	}
+
+	void operator()(TF l, TF h, TF t, int shift = 0)
+	{
+		// y already set by decode_target
+		uint64_t sl = C::scale(l, t, shift), sh = h < t ? C::scale(h, t, shift) : C::M;
+		uint64_t &xi = x[lane];
+		xi = (sh - sl) * (xi >> C::SCALE) + y - sl;
+		if (xi < C::L) xi = (xi << 32) | is.get_le32();
+
+		if (++lane == C::LANES) lane = 0;
+		--left;
+	}
+	template <typename S>
+	typename S::SymType operator()(S &freq)
+	{
+		C::bound(freq, 0);
+		TF l, h, t = freq.total();
+		TF target = decode_target(t, S::SHIFT);
+		typename S::SymType s = freq.symbol(target, l, h);
+		(*this)(l, h, t, S::SHIFT);
+		return s;
+	}
+};
+
+}
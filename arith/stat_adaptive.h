@@ -32,6 +32,7 @@ struct AdaptiveStatisticsModule {
 	static const int b = sizeof(TF) * 8;
 	static const int f = b - 2;
 	static const TF FFULL = TF(1) << f;
+	static const int SHIFT = 0; // the total is no power of two
 
 	std::vector<TF> F, C;
 	TC n;
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+/*
+ * Implementation of an adaptive binary probability in the style of LZMA / CABAC.
+ *
+ * Related publications:
+ * Marpe, Detlev, Heiko Schwarz, and Thomas Wiegand. "Context-based adaptive binary arithmetic coding in the H.264/AVC video compression standard." IEEE Transactions on Circuits and Systems for Video Technology 13.7 (2003): 620-636.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace arith {
+
+// Statistics module for the symbols 0 and 1. The probability of a 0 is kept with BITS bits precision and moves by 1/2^RATE
+// towards the coded symbol. The total is a power of two, so the coders do not divide.
+template <int BITS = 12, int RATE = 5, typename TF = uint64_t, typename TS = uint32_t>
+struct BitStatisticsModule {
+	typedef TF FreqType;
+	typedef TS SymType;
+
+	static const int SHIFT = BITS;
+	static const uint32_t TOTAL = uint32_t(1) << BITS;
+
+	uint16_t p; // probability of a 0, always in [1, TOTAL - 1]
+
+	BitStatisticsModule() : p(TOTAL / 2)
+	{}
+
+	void range(TS s, TF &l, TF &h) const
+	{
+		l = s == 0 ? 0 : p;
+		h = s == 0 ? p : TOTAL;
+	}
+	TF total() const
+	{
+		return TOTAL;
+	}
+	TS symbol(TF target, TF &l, TF &h) const
+	{
+		TS s = target >= p;
+		range(s, l, h);
+		return s;
+	}
+	void inc(TS s)
+	{
+		if (s == 0) p += (TOTAL - p) >> RATE;
+		else p -= p >> RATE;
+	}
+};
+
+}
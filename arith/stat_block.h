@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace arith {
+
+// Cumulative frequency table for alphabets of up to 256 symbols, which stores 32 bit counts in 16 blocks of 16 symbols.
+// Every symbol knows the cumulative count within its block and every block knows the cumulative count of all blocks up
+// to itself. Therefore, range() is a constant-time lookup, inc() touches at most two blocks of 16 counts and symbol()
+// consists of two searches over 16 counts each, which use AVX2 or SSE2 compares if available.
+// Counts are halved like in AdaptiveStatisticsModule, but already above 2^30 since all values have to fit into signed 32 bit
+// integers for the compares.
+template <typename TF = uint64_t, typename TS = uint32_t, typename TC = uint32_t>
+struct BlockStatisticsModule {
+	typedef TF FreqType;
+	typedef TS SymType;
+	typedef TC CountType;
+
+	static const int SHIFT = 0; // the total is no power of two
+	static const int BLOCK = 16, NBLOCKS = 16, MAXN = BLOCK * NBLOCKS;
+	static const uint32_t FFULL = uint32_t(1) << 30;
+
+	alignas(32) uint32_t C[MAXN]; // counts
+	alignas(32) uint32_t E[MAXN]; // exclusive cumulative counts within the block
+	alignas(32) uint32_t BI[NBLOCKS]; // inclusive cumulative counts of the blocks
+	TC n;
+
+	BlockStatisticsModule(TC _n = 256) : n(_n)
+	{
+		std::fill(C, C + MAXN, 0);
+		std::fill(E, E + MAXN, 0);
+		std::fill(BI, BI + NBLOCKS, 0);
+	}
+
+	BlockStatisticsModule(const BlockStatisticsModule&) = delete;
+	BlockStatisticsModule &operator=(const BlockStatisticsModule&) = delete;
+
+	void range(TS s, TF &l, TF &h) const
+	{
+		TS b = s / BLOCK;
+		l = (b == 0 ? 0 : BI[b - 1]) + E[s];
+		h = l + C[s];
+	}
+	TF total() const
+	{
+		return BI[NBLOCKS - 1];
+	}
+	TS symbol(TF target, TF &l, TF &h) const
+	{
+		uint32_t t = target;
+		TS b = count_le(BI, t); // number of blocks which end at or before the target
+		uint32_t off = b == 0 ? 0 : BI[b - 1];
+		TS s = b * BLOCK + count_le(E + b * BLOCK, t - off) - 1;
+		l = off + E[s];
+		h = l + C[s];
+		return s;
+	}
+	void init(TS s, TF incr = 1)
+	{
+		inc(s, incr);
+	}
+	void inc(TS s, TF inc = 1)
+	{
+		inc_impl(s, inc);
+
+		if (total() > FFULL) halve();
+	}
+	TF frequency(TS s) const
+	{
+		return C[s];
+	}
+	void set(TS s, TF f)
+	{
+		inc_impl(s, f - frequency(s));
+	}
+	void halve()
+	{
+		for (TS i = 0; i < MAXN; ++i) {
+			C[i] -= C[i] >> 1;
+		}
+		rebuild();
+	}
+
+private:
+	// counts the entries of a (16 entries, 32 byte aligned) which are <= t
+	static TS count_le(const uint32_t *a, uint32_t t)
+	{
+#if defined(__AVX2__)
+		__m256i vt = _mm256_set1_epi32(t);
+		__m256i gt0 = _mm256_cmpgt_epi32(_mm256_load_si256((const __m256i*)a), vt);
+		__m256i gt1 = _mm256_cmpgt_epi32(_mm256_load_si256((const __m256i*)(a + 8)), vt);
+		uint32_t m = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(gt0)) | (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(gt1)) << 8;
+		return 16 - __builtin_popcount(m);
+#elif defined(__SSE2__)
+		__m128i vt = _mm_set1_epi32(t);
+		uint32_t m = 0;
+		for (int i = 0; i < 4; ++i) {
+			__m128i gt = _mm_cmpgt_epi32(_mm_load_si128((const __m128i*)(a + 4 * i)), vt);
+			m |= (uint32_t)_mm_movemask_ps(_mm_castsi128_ps(gt)) << (4 * i);
+		}
+		return 16 - __builtin_popcount(m);
+#else
+		TS c = 0;
+		for (int i = 0; i < 16; ++i) {
+			c += a[i] <= t;
+		}
+		return c;
+#endif
+	}
+
+	// adds inc to the entries i >= first of a (16 entries, 32 byte aligned), masked instead of a loop with a varying trip count
+	static void add_from(uint32_t *a, TS first, uint32_t inc)
+	{
+#if defined(__AVX2__)
+		__m256i vf = _mm256_set1_epi32(first - 1), vi = _mm256_set1_epi32(inc);
+		__m256i *p0 = (__m256i*)a, *p1 = (__m256i*)(a + 8);
+		__m256i m0 = _mm256_cmpgt_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), vf);
+		__m256i m1 = _mm256_cmpgt_epi32(_mm256_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15), vf);
+		_mm256_store_si256(p0, _mm256_add_epi32(_mm256_load_si256(p0), _mm256_and_si256(m0, vi)));
+		_mm256_store_si256(p1, _mm256_add_epi32(_mm256_load_si256(p1), _mm256_and_si256(m1, vi)));
+#elif defined(__SSE2__)
+		__m128i vf = _mm_set1_epi32(first - 1), vi = _mm_set1_epi32(inc);
+		for (int i = 0; i < 4; ++i) {
+			__m128i *p = (__m128i*)(a + 4 * i);
+			__m128i m = _mm_cmpgt_epi32(_mm_setr_epi32(4 * i, 4 * i + 1, 4 * i + 2, 4 * i + 3), vf);
+			_mm_store_si128(p, _mm_add_epi32(_mm_load_si128(p), _mm_and_si128(m, vi)));
+		}
+#else
+		for (TS i = 0; i < 16; ++i) {
+			a[i] += i >= first ? inc : 0;
+		}
+#endif
+	}
+
+	void inc_impl(TS s, uint32_t inc)
+	{
+		C[s] += inc;
+		add_from(E + s / BLOCK * BLOCK, s % BLOCK + 1, inc);
+		add_from(BI, s / BLOCK, inc);
+	}
+	void rebuild()
+	{
+		uint32_t acc = 0;
+		for (TS b = 0; b < NBLOCKS; ++b) {
+			uint32_t e = 0;
+			for (TS i = b * BLOCK; i < (b + 1) * BLOCK; ++i) {
+				E[i] = e;
+				e += C[i];
+			}
+			acc += e;
+			BI[b] = acc;
+		}
+	}
+};
+
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <stdint.h>
+
+namespace arith {
+
+// Statistics module whose total is always 2^BITS, which allows the coders to replace the division by the total with a shift.
+// The adaptive counts are mapped onto a cumulative table periodically; the period doubles up to MAXPERIOD increments.
+// Symbols which have never been initialized or incremented get no range. BITS must be large enough to give every other symbol at least 1.
+// The tables hold up to N symbols inline, so that a model does not allocate.
+template <int BITS = 15, int N = 256, typename TF = uint64_t, typename TS = uint32_t, typename TC = uint32_t>
+struct Pow2StatisticsModule {
+	typedef TF FreqType;
+	typedef TS SymType;
+	typedef TC CountType;
+
+	static const int SHIFT = BITS;
+	static const TF TOTAL = TF(1) << BITS;
+	static const TC MINPERIOD = 4, MAXPERIOD = 256;
+	static const TF FFULL = TF(1) << 32; // counts are halved above, which keeps the fixed-point factor of the rescaling exact enough
+
+	TF C[N], cum[N + 1];
+	TC n, used; // symbols >= used have never been seen
+	TF sum;
+	TC period, left;
+
+	Pow2StatisticsModule(TC _n = N) : n(_n), used(0), sum(0), period(MINPERIOD), left(MINPERIOD)
+	{
+		std::fill(C, C + N, 0);
+		std::fill(cum, cum + N + 1, 0);
+	}
+
+	Pow2StatisticsModule(const Pow2StatisticsModule&) = delete;
+	Pow2StatisticsModule &operator=(const Pow2StatisticsModule&) = delete;
+
+	void range(TS s, TF &l, TF &h) const
+	{
+		l = cum[s];
+		h = cum[s + 1];
+	}
+	TF total() const
+	{
+		return TOTAL;
+	}
+	TS symbol(TF target, TF &l, TF &h) const
+	{
+		TS s = std::upper_bound(cum + 1, cum + used + 1, target) - cum - 1;
+		range(s, l, h);
+		return s;
+	}
+	void init(TS s, TF incr = 1)
+	{
+		C[s] += incr;
+		sum += incr;
+		used = std::max<TC>(used, s + 1);
+		rescale();
+	}
+	void inc(TS s, TF inc = 1)
+	{
+		C[s] += inc;
+		sum += inc;
+		if (--left == 0) {
+			if (sum > FFULL) halve();
+			rescale();
+			period = std::min<TC>(period * 2, MAXPERIOD);
+			left = period;
+		}
+	}
+	TF frequency(TS s) const
+	{
+		return C[s];
+	}
+	void set(TS s, TF f)
+	{
+		sum += f - C[s];
+		C[s] = f;
+		rescale();
+	}
+	void halve()
+	{
+		sum = 0;
+		for (TS i = 0; i < used; ++i) {
+			C[i] -= C[i] >> 1;
+			sum += C[i];
+		}
+	}
+
+private:
+	void rescale()
+	{
+		TC nz = 0;
+		TS maxs = 0;
+		for (TS i = 0; i < used; ++i) {
+			if (C[i] != 0) ++nz;
+			if (C[i] > C[maxs]) maxs = i;
+		}
+
+		// every seen symbol gets 1 plus its share of the remainder, rounding errors go to the most probable one
+		TF f = ((TOTAL - nz) << 32) / sum, acc = 0; // 32.32 fixed-point
+		for (TS i = 0; i < used; ++i) {
+			cum[i] = acc;
+			if (C[i] != 0) acc += 1 + (C[i] * f >> 32);
+		}
+		cum[used] = acc;
+		for (TS i = maxs + 1; i <= used; ++i) {
+			cum[i] += TOTAL - acc;
+		}
+		std::fill(cum + used + 1, cum + n + 1, TOTAL);
+	}
+};
+
+}
@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace arith {
+
+// Cumulative frequency table for small alphabets of up to N symbols, which is indexed directly.
+// inc() updates the following entries of the table, symbol() counts the entries <= target without branches.
+// Counts are halved at the same threshold as in AdaptiveStatisticsModule, therefore both yield the same code.
+template <int N = 16, typename TF = uint64_t, typename TS = uint32_t, typename TC = uint32_t>
+struct SmallStatisticsModule {
+	typedef TF FreqType;
+	typedef TS SymType;
+	typedef TC CountType;
+
+	static const int SHIFT = 0; // the total is no power of two
+	static const int b = sizeof(TF) * 8;
+	static const int f = b - 2;
+	static const TF FFULL = TF(1) << f;
+
+	TF cum[N + 1]; // cum[s] is the cumulative count of all symbols < s
+	TC n;
+
+	SmallStatisticsModule(TC _n = N) : n(_n)
+	{
+		std::fill(cum, cum + N + 1, 0);
+	}
+
+	SmallStatisticsModule(const SmallStatisticsModule&) = delete;
+	SmallStatisticsModule &operator=(const SmallStatisticsModule&) = delete;
+
+	void range(TS s, TF &l, TF &h) const
+	{
+		l = cum[s];
+		h = cum[s + 1];
+	}
+	TF total() const
+	{
+		return cum[N];
+	}
+	TS symbol(TF target, TF &l, TF &h) const
+	{
+		TS s = 0;
+		for (int i = 1; i < N; ++i) {
+			s += cum[i] <= target;
+		}
+		range(s, l, h);
+		return s;
+	}
+	void init(TS s, TF incr = 1)
+	{
+		inc(s, incr);
+	}
+	void inc(TS s, TF inc = 1)
+	{
+		inc_impl(s, inc);
+
+		if (total() > FFULL) halve();
+	}
+	TF frequency(TS s) const
+	{
+		return cum[s + 1] - cum[s];
+	}
+	void set(TS s, TF f)
+	{
+		inc_impl(s, f - frequency(s));
+	}
+	void halve()
+	{
+		TF acc = 0, prev = 0;
+		for (int i = 1; i <= N; ++i) {
+			TF c = cum[i] - prev;
+			prev = cum[i];
+			acc += c - (c >> 1);
+			cum[i] = acc;
+		}
+	}
+
+private:
+	void inc_impl(TS s, TF inc)
+	{
+		for (TS i = 1; i <= N; ++i) {
+			cum[i] += i > s ? inc : 0;
+		}
+	}
+};
+
+}
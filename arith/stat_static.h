@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <stdexcept>
+
+#include "bitstream.h"
+
+namespace arith {
+
+// Statistics module with a fixed table, whose total is 2^BITS. The table is learned in a first pass: inc() counts the symbols
+// while a flat table is used, build() then maps the counts onto the total. Afterwards, inc() does not change anything.
+// symbol() looks up the first candidate with the upper LBITS bits of the target and scans forward from there.
+// Symbols which have never been counted get no range; the table is stored with write() and restored with read().
+template <int BITS = 15, int N = 256, typename TF = uint64_t, typename TS = uint32_t, typename TC = uint32_t>
+struct StaticStatisticsModule {
+	typedef TF FreqType;
+	typedef TS SymType;
+	typedef TC CountType;
+	static_assert(N <= 256, "The lookup table stores 8 bit symbols");
+
+	static const int SHIFT = BITS;
+	static const uint32_t TOTAL = uint32_t(1) << BITS;
+	static const int LBITS = BITS < 12 ? BITS : 12;
+
+	TF C[N]; // counts of the learning pass
+	uint32_t cum[N + 1];
+	uint8_t first[1 << LBITS]; // first symbol whose range intersects the slot of the lookup table
+	TC n;
+	bool learn;
+
+	StaticStatisticsModule(TC _n = N) : n(_n), learn(true)
+	{
+		std::fill(C, C + N, 0);
+		set_uniform();
+	}
+
+	StaticStatisticsModule(const StaticStatisticsModule&) = delete;
+	StaticStatisticsModule &operator=(const StaticStatisticsModule&) = delete;
+
+	void range(TS s, TF &l, TF &h) const
+	{
+		l = cum[s];
+		h = cum[s + 1];
+	}
+	TF total() const
+	{
+		return TOTAL;
+	}
+	TS symbol(TF target, TF &l, TF &h) const
+	{
+		TS s = first[target >> (BITS - LBITS)];
+		while (cum[s + 1] <= target) ++s;
+		range(s, l, h);
+		return s;
+	}
+	void init(TS, TF = 1)
+	{}
+	void inc(TS s, TF inc = 1)
+	{
+		if (learn) C[s] += inc;
+	}
+	TF frequency(TS s) const
+	{
+		return cum[s + 1] - cum[s];
+	}
+	void halve()
+	{}
+
+	// maps the counts onto the total: every counted symbol gets 1 plus its share of the remainder, rounding errors go to the most probable one
+	void build()
+	{
+		learn = false;
+		TC nz = 0;
+		TS maxs = 0;
+		TF sum = 0;
+		for (TS i = 0; i < n; ++i) {
+			if (C[i] != 0) ++nz;
+			if (C[i] > C[maxs]) maxs = i;
+			sum += C[i];
+		}
+
+		uint32_t f[N], acc = 0;
+		for (TS i = 0; i < n; ++i) {
+			f[i] = C[i] == 0 ? 0 : 1 + C[i] * (TOTAL - nz) / sum;
+			acc += f[i];
+		}
+		if (sum != 0) f[maxs] += TOTAL - acc;
+		set_table(f);
+	}
+
+	// frequencies as LEB128 numbers, a zero is followed by the number of further zeros
+	void write(memostream &os) const
+	{
+		for (TS i = 0; i < n;) {
+			uint32_t f = frequency(i);
+			put_uint(os, f);
+			++i;
+			if (f != 0) continue;
+			TS j = i;
+			while (j < n && frequency(j) == 0) ++j;
+			put_uint(os, j - i);
+			i = j;
+		}
+	}
+	void read(memistream &is)
+	{
+		learn = false;
+		uint32_t f[N];
+		uint64_t sum = 0;
+		for (TS i = 0; i < n;) {
+			f[i] = get_uint(is);
+			if (f[i] > TOTAL) throw std::runtime_error("Invalid static model table");
+			sum += f[i];
+			++i;
+			if (f[i - 1] != 0) continue;
+			uint32_t z = get_uint(is);
+			if (z > n - i) throw std::runtime_error("Invalid static model table");
+			std::fill(f + i, f + i + z, 0);
+			i += z;
+		}
+		if (sum != 0 && sum != TOTAL) throw std::runtime_error("Invalid static model table");
+		if (sum == 0) set_uniform(); // the model codes no symbol, the table keeps symbol() within the alphabet
+		else set_table(f);
+	}
+
+private:
+	void set_uniform()
+	{
+		uint32_t f[N];
+		for (TC i = 0; i < n; ++i) {
+			f[i] = TOTAL / n + (i < TOTAL % n);
+		}
+		set_table(f);
+	}
+	void set_table(const uint32_t *f)
+	{
+		cum[0] = 0;
+		for (TS i = 0; i < n; ++i) {
+			cum[i + 1] = cum[i] + f[i];
+		}
+		std::fill(cum + n + 1, cum + N + 1, cum[n]);
+
+		TS s = 0;
+		for (uint32_t i = 0; i < (1 << LBITS); ++i) {
+			while (s + 1 < n && cum[s + 1] <= i << (BITS - LBITS)) ++s;
+			first[i] = s;
+		}
+	}
+
+	static void put_uint(memostream &os, uint32_t v)
+	{
+		for (; v >= 0x80; v >>= 7) os.put((v & 0x7f) | 0x80);
+		os.put(v);
+	}
+	static uint32_t get_uint(memistream &is)
+	{
+		uint32_t v = 0;
+		for (int sh = 0; sh < 35; sh += 7) {
+			uint8_t c = is.get();
+			v |= uint32_t(c & 0x7f) << sh;
+			if (!(c & 0x80)) break;
+		}
+		return v;
+	}
+};
+
+}
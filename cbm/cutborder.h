@@ -17,8 +17,9 @@
 
 #pragma once
 
-#include <deque>
-#include <list>
+#include <stdint.h>
+#include <algorithm>
+#include <limits>
 #include <vector>
 
 #include "base.h"
@@ -46,54 +47,125 @@ std::ostream &operator<<(std::ostream &os, const DataTpl<T, V> &d)
 	return os << d.idx << " [" << (T)d << "]";
 }
 
-template <typename T, typename V>
+// The elements of all parts are nodes of one pool, which are linked by indices. Each part is a circular list and is
+// referred to by its first node, therefore splitting and joining parts only relinks a few nodes. Released nodes are
+// kept in a free list, so the cut-border does not allocate once the pool has grown to its peak size.
+//
+// The parts are kept in slots, which are stable handles. Their order is a stack of handles, the current part is on top.
+// A union removes the other part by marking its entry as dead; dead entries are dropped when they reach the top or when
+// they make up half of the stack, so a union takes constant amortized time and the part offsets count live entries only.
+//
+// With LOOKUP (needed by the encoder only), the nodes of each vertex are chained, so split and union targets are found
+// without searching the cut-border. The first node of each part is marked; the position of a node is found by walking
+// to the nearer end of its part, which takes as many steps as the decoder needs to find the element by its offset.
+template <typename T, typename V, bool LOOKUP = false>
 struct CutBorder {
 	typedef DataTpl<T, V> Data;
-	typedef std::list<Data> Elements;
-	struct Part : Elements {
+	typedef uint32_t Elem;
+	static const Elem NIL = std::numeric_limits<Elem>::max();
+	static const int SEARCH = 8; // steps of the direct search
+
+	struct Node : Data {
+		Elem prev, next;
+		Elem vnext; // next node of the same vertex
+		bool head;
+
+		Node(const Data &d) : Data(d)
+		{}
+	};
+	struct Part {
+		Elem head; // front of the circular list
+		std::size_t n;
 		bool isEdgeBegin;
-		Part() : isEdgeBegin(true)
+		Part() : head(NIL), n(0), isEdgeBegin(true)
 		{}
 
+		std::size_t size()
+		{
+			return n;
+		}
 		std::size_t num_edges()
 		{
-			return this->size() - (isEdgeBegin ? 0 : 1);
+			return n - (isEdgeBegin ? 0 : 1);
 		}
 	};
-	typedef std::deque<Part> Parts;
-	Parts parts;
+	typedef uint32_t Handle;
+	std::vector<Part> slots;
+	std::vector<Handle> freeslots;
+	std::vector<Handle> order; // bottom to top, NIL marks a removed part
+	std::size_t ndead;
+	std::vector<Node> nodes;
+	Elem freelist;
 	Data *first, *second;
 
 	// acceleration structure for fast lookup if a vertex is currently on the cutboder
 	std::vector<unsigned char> vertices;
+	std::vector<Elem> vnodes; // first node of each vertex
 
-	CutBorder(V num_vtx = 0) : vertices(num_vtx, 0)
-	{}
+	CutBorder(V num_vtx = 0) : ndead(0), freelist(NIL), vertices(num_vtx, 0), vnodes(LOOKUP ? num_vtx : 0, NIL)
+	{
+		nodes.reserve(num_vtx);
+	}
 
 	Part &cur_part()
 	{
-		return parts.back();
+		return slots[order.back()];
+	}
+	Part &part(int p)
+	{
+		return slots[order[index(p)]];
 	}
 
 	bool atEnd()
 	{
-		return parts.empty();
+		return order.empty();
+	}
+
+	// entry of the part with the offset p from the top
+	std::size_t index(int p)
+	{
+		std::size_t k = order.size() - 1;
+		for (; p != 0 || order[k] == NIL; --k) {
+			if (order[k] != NIL) --p;
+		}
+		return k;
+	}
+
+	Data &data(Elem e)
+	{
+		return nodes[e];
+	}
+	Elem next(Elem e)
+	{
+		return nodes[e].next;
+	}
+	Elem prev(Elem e)
+	{
+		return nodes[e].prev;
+	}
+	Elem front(Part &part)
+	{
+		return part.head;
+	}
+	Elem back(Part &part)
+	{
+		return nodes[part.head].prev;
 	}
 
 	void traverseStep(Data &v0, Data &v1)
 	{
 		Part &part = cur_part();
-		v0 = part.back();
-		v1 = part.front();
+		v0 = data(back(part));
+		v1 = data(front(part));
 	}
 
 	const Data &left() // previous on cut-border
 	{
-		return *(++cur_part().rbegin());
+		return data(prev(back(cur_part())));
 	}
 	const Data &right() // next on cut-border
 	{
-		return cur_part().front();
+		return data(front(cur_part()));
 	}
 
 	void activate_vertex(V i)
@@ -112,85 +184,104 @@ struct CutBorder {
 		return vertices[i] != 0;
 	}
 
-	typename Elements::iterator get_element(int i, int p = 0)
+	// position of element i counted from the front of its part
+	std::size_t position(int i, int p = 0)
 	{
-		Part &part = parts[parts.size() - 1 - p];
-
-		if (i > 0)
-			return std::next(part.begin(), i - 1);
-		else
-			return std::prev(part.end(), -i + 1);
+		return i > 0 ? i - 1 : part(p).size() - 1 + i;
 	}
-	typename Elements::iterator find_element(Data v, int &i, int &p)
+	Elem get_element(int i, int p = 0)
 	{
-		// search vertex in both directions
-		typename Parts::reverse_iterator part = parts.rbegin();
-		typename Elements::reverse_iterator l = part->rbegin();
-		typename Elements::iterator r = part->begin();
+		Part &part = this->part(p);
 
-		i = 0; p = 0;
-		while (1) {
-			if (r->idx == v.idx) {
+		Elem e;
+		if (i > 0) {
+			e = front(part);
+			for (int j = 1; j < i; ++j) e = next(e);
+		} else {
+			e = back(part);
+			for (int j = 0; j < -i; ++j) e = prev(e);
+		}
+		return e;
+	}
+	// Yields the same element as a search from both ends of each part, which starts at the current part. Short distances
+	// in the current part are searched directly; otherwise, among the nodes of the vertex, the one in the nearest part and
+	// nearest to an end of it wins, on a tie the one counted from the front.
+	Elem find_element(Data v, int &i, int &p)
+	{
+		static_assert(LOOKUP, "The vertex nodes are not maintained");
+		Part &part = cur_part();
+		Elem l = back(part), r = front(part);
+		p = 0;
+		for (i = 0; i < SEARCH; ++i) {
+			if (data(r).idx == v.idx) {
 				++i;
 				return r;
-			} else if (l->idx == v.idx) {
+			} else if (data(l).idx == v.idx) {
 				i = -i;
-				return std::prev(l.base());
+				return l;
 			}
+			if (l == r || (i != 0 && next(l) == r)) break; // the list is circular, so next(l) is r in the first step
+			r = next(r); l = prev(l);
+		}
 
-			if (std::prev(l.base()) == r || l.base() == r) {
-				++p;
-				++part;
-#ifdef HAVE_ASSERT
-				assert(part != parts.rend());
-#endif
-				r = part->begin();
-				l = part->rbegin();
-				i = 0;
-			} else {
-				++r; ++l;
-				++i;
+		Elem best = NIL;
+		int bestd = 0;
+		for (Elem e = vnodes[v.idx]; e != NIL; e = nodes[e].vnext) {
+			// walk to both ends at once, the first node of the part is marked
+			Elem l = e, r = e, h;
+			int d = 0;
+			bool fromfront;
+			while (1) {
+				if (nodes[l].head) { fromfront = true; h = l; break; }
+				if (nodes[next(r)].head) { fromfront = false; h = next(r); break; }
+				l = prev(l); r = next(r); ++d;
+			}
+			int q = 0;
+			for (std::size_t k = order.size() - 1; order[k] == NIL || slots[order[k]].head != h; --k) {
+				if (order[k] != NIL) ++q;
+			}
+			if (best == NIL || q < p || (q == p && (d < bestd || (d == bestd && fromfront)))) {
+				best = e; p = q; bestd = d; i = fromfront ? d + 1 : -d;
 			}
 		}
+#ifdef HAVE_ASSERT
+		assert(best != NIL);
+#endif
+		return best;
 	}
 
 	void initial(Data v0, Data v1, Data v2)
 	{
-		parts.emplace_back();
+		push_part();
 		Part &part = cur_part();
-		part.push_back(v0); activate_vertex(v0.idx);
-		part.push_back(v1); activate_vertex(v1.idx);
-		part.push_back(v2); activate_vertex(v2.idx);
+		push_back(part, v0); activate_vertex(v0.idx);
+		push_back(part, v1); activate_vertex(v1.idx);
+		push_back(part, v2); activate_vertex(v2.idx);
 	}
 
 	void newVertex(Data v)
 	{
 		Part &part = cur_part();
-		first = &part.back();
-		part.push_back(v); activate_vertex(v.idx);
-		second = &part.back();
+		push_back(part, v); activate_vertex(v.idx);
+		second = &data(back(part));
+		first = &data(prev(back(part)));
 	}
 	Data connectForward(OP &op)
 	{
 		Part &part = cur_part();
-		Data d = *(++part.begin());
+		Data d = data(next(front(part)));
 		if (!part.isEdgeBegin) {
 			op = border();
 			return Data();
 		} else if (istri()) {
-			typename Elements::iterator it = part.begin();
-			deactivate_vertex((it++)->idx);
-			deactivate_vertex((it++)->idx);
-			deactivate_vertex((it++)->idx);
-
-			parts.pop_back();
+			release_part();
 			op = CLOSE;
 		} else {
-			deactivate_vertex(part.front().idx);
-			part.pop_front();
+			deactivate_vertex(data(front(part)).idx);
+			pop_front(part);
 
 			op = CONNFWD;
-			first = &cur_part().back();
+			first = &data(back(part));
 		}
 		return d;
 	}
@@ -199,13 +290,13 @@ struct CutBorder {
 		Part &part = cur_part();
 
 		// NOTE: border and close operations are always renamed to connect forward
-		deactivate_vertex(part.back().idx);
-		part.pop_back();
+		deactivate_vertex(data(back(part)).idx);
+		pop_back(part);
 
 		op = CONNBWD;
-		first = &part.back();
+		first = &data(back(part));
 
-		return part.back();
+		return data(back(part));
 	}
 
 	bool istri()
@@ -221,24 +312,21 @@ struct CutBorder {
 #ifdef HAVE_ASSERT
 			assert_eq(part.size(), 2);
 #endif
-			typename Elements::iterator it = part.begin();
-			deactivate_vertex((it++)->idx);
-			deactivate_vertex((it++)->idx);
-			parts.pop_back();
+			release_part();
 		} else {
-			Data endvtx = part.back();
+			Data endvtx = data(back(part));
 
 			bool rename = !part.isEdgeBegin;
 
-			deactivate_vertex(part.back().idx);
-			part.pop_back();
+			deactivate_vertex(endvtx.idx);
+			pop_back(part);
 
 			if (!part.isEdgeBegin) {
-				deactivate_vertex(part.front().idx);
-				part.pop_front();
+				deactivate_vertex(data(front(part)).idx);
+				pop_front(part);
 			}
 
-			part.push_front(endvtx); activate_vertex(endvtx.idx);
+			push_front(part, endvtx); activate_vertex(endvtx.idx);
 			part.isEdgeBegin = false;
 
 			if (rename) return CONNFWD;
@@ -247,53 +335,74 @@ struct CutBorder {
 		return BORDER;
 	}
 
-	Data splitCutBorder(typename Elements::iterator it)
+	// it is the element at position pos of the current part
+	Data splitCutBorder(Elem it, std::size_t pos)
 	{
-		Part &part = cur_part();
-		Data gate = part.back();
+		Part *part = &cur_part();
+		Data gate = data(back(*part));
 		deactivate_vertex(gate.idx);
-		part.pop_back();
+		pop_back(*part);
 
-		parts.emplace_back();
+		Handle h = order.back();
+		push_part();
+		part = &slots[h];
 		Part &newpart = cur_part();
-		newpart.splice(newpart.begin(), part, part.begin(), it);
-		part.push_back(gate); activate_vertex(gate.idx);
-		newpart.push_back(*it); activate_vertex(it->idx);
-		std::swap(part.isEdgeBegin, newpart.isEdgeBegin);
+		// move the elements before it to the new part
+		if (pos != 0) {
+			Elem a = front(*part), b = prev(it), t = back(*part);
+			nodes[it].prev = t; nodes[t].next = it;
+			nodes[b].next = a; nodes[a].prev = b;
+			set_head(*part, it);
+			set_head(newpart, a);
+			part->n -= pos;
+			newpart.n = pos;
+		}
+		Data res = data(it);
+		push_back(*part, gate); activate_vertex(gate.idx);
+		push_back(newpart, res); activate_vertex(res.idx);
+		std::swap(part->isEdgeBegin, newpart.isEdgeBegin);
 
-		second = &newpart.back();
-		first = &part.back();
+		second = &data(back(newpart));
+		first = &data(back(*part));
 
-		return *it;
+		return res;
 	}
 	Data splitCutBorder(int i)
 	{
-		return splitCutBorder(get_element(i));
+		return splitCutBorder(get_element(i), position(i));
 	}
 
-	Data cutBorderUnion(typename Elements::iterator it, int p)
+	Data cutBorderUnion(Elem it, int p)
 	{
 		Part &part = cur_part();
-		Data gate = part.back();
+		Data gate = data(back(part));
 		deactivate_vertex(gate.idx);
-		part.pop_back();
-
-		Part &otherpart = parts[parts.size() - 1 - p];
-		part.push_back(gate); activate_vertex(gate.idx);
-		first = &part.back();
-		part.splice(part.end(), otherpart, it, otherpart.end());
-		part.splice(part.end(), otherpart, otherpart.begin(), otherpart.end()); // it is now end
-		part.push_back(*it); activate_vertex(it->idx);
-		second = &part.back();
-
-		// move part to front
-		for (typename Parts::iterator it = parts.begin() + (parts.size() - 1 - p); it < parts.end() - 1; ++it) {
-			it->swap(it[1]);
-			std::swap(it->isEdgeBegin, it[1].isEdgeBegin);
+		pop_back(part);
+
+		std::size_t k = index(p);
+		Part &otherpart = slots[order[k]];
+		push_back(part, gate); activate_vertex(gate.idx);
+		Elem g = back(part);
+		// append the other part, starting at it
+		Elem a = front(part), b = prev(it);
+		nodes[g].next = it; nodes[it].prev = g;
+		nodes[b].next = a; nodes[a].prev = b;
+		nodes[otherpart.head].head = false;
+		part.n += otherpart.n;
+		Data res = data(it);
+		push_back(part, res); activate_vertex(res.idx);
+		second = &data(back(part));
+		first = &data(g);
+
+		// remove the other part, the order of the remaining parts is kept
+		freeslots.push_back(order[k]);
+		order[k] = NIL;
+		if (++ndead * 2 > order.size()) {
+			order.erase(std::remove(order.begin(), order.end(), NIL), order.end());
+			ndead = 0;
 		}
-		parts.pop_back();
 
-		return *it;
+		return res;
 	}
 	Data cutBorderUnion(int i, int p)
 	{
@@ -303,33 +412,142 @@ struct CutBorder {
 	bool findAndUpdate(Data v, int &i, int &p, OP &op)
 	{
 		if (!on_cut_border(v.idx)) return false;
-		typename Elements::iterator it = find_element(v, i, p);
+		Elem it = find_element(v, i, p);
 #ifdef HAVE_ASSERT
-		assert_eq(get_element(i, p)->idx, v.idx);
+		assert_eq(data(get_element(i, p)).idx, v.idx);
 #endif
 
 		if (p > 0) {
 			op = UNION;
-			Data res = cutBorderUnion(it, p);
 #ifdef HAVE_ASSERT
+			Data res = cutBorderUnion(it, p);
 			assert_eq(res.idx, v.idx);
+#else
+			cutBorderUnion(it, p);
 #endif
 		} else {
 			Part &part = cur_part();
-			if (part.isEdgeBegin && (++part.begin())->idx == v.idx) {
+			if (part.isEdgeBegin && data(next(front(part))).idx == v.idx) {
 				connectForward(op);
-			} else if ((++part.rbegin())->idx == v.idx) {
+			} else if (data(prev(back(part))).idx == v.idx) {
 				connectBackward(op);
 			} else {
 				op = SPLIT;
-				Data res = splitCutBorder(it);
 #ifdef HAVE_ASSERT
+				Data res = splitCutBorder(it, position(i));
 				assert_eq(res.idx, v.idx);
+#else
+				splitCutBorder(it, position(i));
 #endif
 			}
 		}
 		return true;
 	}
+
+private:
+	void push_part()
+	{
+		if (freeslots.empty()) {
+			order.push_back(slots.size());
+			slots.emplace_back();
+		} else {
+			order.push_back(freeslots.back());
+			freeslots.pop_back();
+			slots[order.back()] = Part();
+		}
+	}
+
+	void set_head(Part &part, Elem e)
+	{
+		if (part.head != NIL) nodes[part.head].head = false;
+		part.head = e;
+		if (e != NIL) nodes[e].head = true;
+	}
+
+	Elem alloc(const Data &d)
+	{
+		Elem e;
+		if (freelist == NIL) {
+			nodes.emplace_back(d);
+			e = nodes.size() - 1;
+		} else {
+			e = freelist;
+			freelist = nodes[e].next;
+			static_cast<Data&>(nodes[e]) = d;
+		}
+		nodes[e].head = false;
+		if (LOOKUP) {
+			nodes[e].vnext = vnodes[d.idx];
+			vnodes[d.idx] = e;
+		}
+		return e;
+	}
+	void release(Elem e)
+	{
+		if (LOOKUP) {
+			Elem *l = &vnodes[data(e).idx];
+			while (*l != e) l = &nodes[*l].vnext;
+			*l = nodes[e].vnext;
+		}
+		nodes[e].next = freelist;
+		freelist = e;
+	}
+
+	void push_back(Part &part, const Data &d)
+	{
+		Elem e = alloc(d);
+		if (part.head == NIL) {
+			nodes[e].prev = nodes[e].next = e;
+			set_head(part, e);
+		} else {
+			Elem h = part.head, t = nodes[h].prev;
+			nodes[e].prev = t; nodes[e].next = h;
+			nodes[t].next = e; nodes[h].prev = e;
+		}
+		++part.n;
+	}
+	void push_front(Part &part, const Data &d)
+	{
+		push_back(part, d);
+		set_head(part, back(part));
+	}
+	void unlink(Part &part, Elem e)
+	{
+		if (--part.n == 0) {
+			set_head(part, NIL);
+		} else {
+			Elem p = nodes[e].prev, n = nodes[e].next;
+			nodes[p].next = n; nodes[n].prev = p;
+			if (part.head == e) set_head(part, n);
+		}
+		release(e);
+	}
+	void pop_back(Part &part)
+	{
+		unlink(part, back(part));
+	}
+	void pop_front(Part &part)
+	{
+		unlink(part, front(part));
+	}
+
+	// removes the current part and deactivates its vertices
+	void release_part()
+	{
+		Part &part = cur_part();
+		Elem e = front(part);
+		for (std::size_t j = 0; j < part.size(); ++j) {
+			Elem n = next(e);
+			deactivate_vertex(data(e).idx);
+			release(e);
+			e = n;
+		}
+		freeslots.push_back(order.back());
+		order.pop_back();
+		for (; !order.empty() && order.back() == NIL; --ndead) order.pop_back();
+	}
 };
+template <typename T, typename V, bool LOOKUP>
+const typename CutBorder<T, V, LOOKUP>::Elem CutBorder<T, V, LOOKUP>::NIL;
 
 }
@@ -69,7 +69,7 @@ void decode(M &mesh, R &rd, A &ac)
 			v0.idx = rd.vertid(); v1.idx = rd.vertid(); v2.idx = rd.vertid();
 			break;
 		}
-		ntri = rd.numtri();
+		ntri = M::tri ? 1 : rd.numtri();
 		++order[v0.idx]; ++order[v1.idx]; ++order[v2.idx];
 
 		f = mesh.add_face(ntri + 2);
@@ -111,6 +111,7 @@ void decode(M &mesh, R &rd, A &ac)
 
 		cutBorder.initial(v0, v1, v2);
 
+		if (curtri == ntri) ac.flush();
 		if (curtri == ntri) ++f;
 
 		while (!cutBorder.atEnd()) {
@@ -157,7 +158,7 @@ void decode(M &mesh, R &rd, A &ac)
 
 			if (!v2.isUndefined()) {
 				if (seq_first) {
-					ntri = rd.numtri();
+					ntri = M::tri ? 1 : rd.numtri();
 					curtri = 0;
 					f = mesh.add_face(ntri + 2);
 					e0 = mesh.edge(f); e1 = mesh.next(e0); e2 = mesh.next(e1);
@@ -205,6 +206,7 @@ void decode(M &mesh, R &rd, A &ac)
 					mesh.merge(gateprev, e1);
 					break;
 				}
+				if (curtri == ntri) ac.flush();
 			}
 		}
 	} while (1);
@@ -25,6 +25,13 @@
 
 namespace cbm {
 
+// the number of triangles of a face is not coded for meshes of triangles only
+template <typename M>
+inline int numtri(int ntri)
+{
+	return M::tri ? 0 : ntri;
+}
+
 template <typename V>
 struct Perm {
 	std::vector<V> perm;
@@ -54,7 +61,7 @@ struct Perm {
 template <typename M, typename W, typename A, typename V = int, typename F = int>
 void encode(M &mesh, W &wr, A &ac)
 {
-	typedef CutBorder<CoderData<typename M::Edge>, V> CutBorder;
+	typedef CutBorder<CoderData<typename M::Edge>, V, true> CutBorder;
 	CutBorder cutBorder(mesh.num_vtx());
 	typedef typename CutBorder::Data Data;
 
@@ -76,43 +83,43 @@ void encode(M &mesh, W &wr, A &ac)
 		INITOP initop;
 		// Tri 3
 		if (m0 && m1 && m2) {
-			wr.tri111(ntri, perm.get(v0.idx), perm.get(v1.idx), perm.get(v2.idx));
+			wr.tri111(numtri<M>(ntri), perm.get(v0.idx), perm.get(v1.idx), perm.get(v2.idx));
 			initop = TRI111;
 		} else if (m0 && m1) {
-			wr.tri110(ntri, perm.get(v0.idx), perm.get(v1.idx));
+			wr.tri110(numtri<M>(ntri), perm.get(v0.idx), perm.get(v1.idx));
 			ac.vtx(f, mesh.edge(e2));
 			perm.map(v2.idx, vertexIdx++);
 			initop = TRI110;
 		} else if (m1 && m2) {
-			wr.tri011(ntri, perm.get(v1.idx), perm.get(v2.idx));
+			wr.tri011(numtri<M>(ntri), perm.get(v1.idx), perm.get(v2.idx));
 			ac.vtx(f, mesh.edge(e0));
 			perm.map(v0.idx, vertexIdx++);
 			initop = TRI011;
 		} else if (m2 && m0) {
-			wr.tri101(ntri, perm.get(v2.idx), perm.get(v0.idx));
+			wr.tri101(numtri<M>(ntri), perm.get(v2.idx), perm.get(v0.idx));
 			ac.vtx(f, mesh.edge(e1));
 			perm.map(v1.idx, vertexIdx++);
 			initop = TRI101;
 		} else if (m0) {
-			wr.tri100(ntri, perm.get(v0.idx));
+			wr.tri100(numtri<M>(ntri), perm.get(v0.idx));
 			ac.vtx(f, mesh.edge(e1));
 			ac.vtx(f, mesh.edge(e2));
 			perm.map(v1.idx, vertexIdx++); perm.map(v2.idx, vertexIdx++);
 			initop = TRI100;
 		} else if (m1) {
-			wr.tri010(ntri, perm.get(v1.idx));
+			wr.tri010(numtri<M>(ntri), perm.get(v1.idx));
 			ac.vtx(f, mesh.edge(e2));
 			ac.vtx(f, mesh.edge(e0));
 			perm.map(v2.idx, vertexIdx++); perm.map(v0.idx, vertexIdx++);
 			initop = TRI010;
 		} else if (m2) {
-			wr.tri001(ntri, perm.get(v2.idx));
+			wr.tri001(numtri<M>(ntri), perm.get(v2.idx));
 			ac.vtx(f, mesh.edge(e0));
 			ac.vtx(f, mesh.edge(e1));
 			perm.map(v0.idx, vertexIdx++); perm.map(v1.idx, vertexIdx++);
 			initop = TRI001;
 		} else {
-			wr.initial(ntri);
+			wr.initial(numtri<M>(ntri));
 			ac.vtx(f, mesh.edge(e0));
 			ac.vtx(f, mesh.edge(e1));
 			ac.vtx(f, mesh.edge(e2));
@@ -129,6 +136,7 @@ void encode(M &mesh, W &wr, A &ac)
 		cutBorder.initial(v0, v1, v2);
 
 		++curtri;
+		if (curtri == ntri) ac.flush();
 
 		while (!cutBorder.atEnd()) {
 			cutBorder.traverseStep(v0, v1);
@@ -140,6 +148,7 @@ void encode(M &mesh, W &wr, A &ac)
 			bool isvalid = true;
 			if (seq_first)
 				e0 = mesh.choose_twin(gate, isvalid);
+			if (seq_first && isvalid) mesh.link(gate, e0);
 
 			wr.order(order[v1.idx]);
 
@@ -173,7 +182,7 @@ void encode(M &mesh, W &wr, A &ac)
 					cutBorder.newVertex(v2);
 					cutBorder.first->init(e1);
 					cutBorder.second->init(e2);
-					wr.newvertex(seq_first ? ntri : 0); // TODO
+					wr.newvertex(seq_first ? numtri<M>(ntri) : 0); // TODO
 					ac.vtx(f, mesh.edge(e2));
 					perm.map(v2.idx, vertexIdx++);
 				} else {
@@ -184,22 +193,25 @@ void encode(M &mesh, W &wr, A &ac)
 						cutBorder.newVertex(v2);
 						cutBorder.first->init(e1);
 						cutBorder.second->init(e2);
-						wr.nm(seq_first ? ntri : 0, perm.get(v2.idx));
+						wr.nm(seq_first ? numtri<M>(ntri) : 0, perm.get(v2.idx));
 					} else if (op == UNION) {
-						wr.cutborderunion(seq_first ? ntri : 0, i, p);
+						wr.cutborderunion(seq_first ? numtri<M>(ntri) : 0, i, p);
 						cutBorder.first->init(e1);
 						cutBorder.second->init(e2);
 					} else if (op == CONNFWD || op == CLOSE) {
 						if (seq_last && mesh.twin(gatenext) != e2) mesh.merge(gatenext, e2);
 						if (op == CLOSE && mesh.twin(gateprev) != e1) mesh.merge(gateprev, e1);
-						wr.connectforward(seq_first ? ntri : 0);
+						if (seq_last) mesh.link(gatenext, e2);
+						if (op == CLOSE) mesh.link(gateprev, e1);
+						wr.connectforward(seq_first ? numtri<M>(ntri) : 0);
 						if (op == CONNFWD) cutBorder.first->init(e1);
 					} else if (op == CONNBWD) {
 						if (mesh.twin(gateprev) != e1) mesh.merge(gateprev, e1);
-						wr.connectbackward(seq_first ? ntri : 0);
+						mesh.link(gateprev, e1);
+						wr.connectbackward(seq_first ? numtri<M>(ntri) : 0);
 						if (op == CONNBWD) cutBorder.first->init(e2);
 					} else {
-						wr.splitcutborder(seq_first ? ntri : 0, i);
+						wr.splitcutborder(seq_first ? numtri<M>(ntri) : 0, i);
 						cutBorder.first->init(e1);
 						cutBorder.second->init(e2);
 					}
@@ -210,6 +222,7 @@ void encode(M &mesh, W &wr, A &ac)
 				if (seq_first) ac.face(f, mesh.edge(e0));
 
 				++curtri;
+				if (curtri == ntri) ac.flush();
 			}
 		}
 	} while (!mesh.empty());
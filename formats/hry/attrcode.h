@@ -9,6 +9,10 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <algorithm>
+#include <cstring>
+#include <deque>
 #include <limits>
 #include <vector>
 
@@ -20,9 +24,58 @@ namespace hry {
 namespace attrcode {
 
 static const mesh::attridx_t UNSET = std::numeric_limits<mesh::attridx_t>::max();
+
+inline uint64_t hash_bytes(const unsigned char *d, std::size_t n)
+{
+	uint64_t h = n, w;
+	for (; n >= 8; d += 8, n -= 8) {
+		std::memcpy(&w, d, 8);
+		h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+		h ^= h >> 32;
+	}
+	w = 0;
+	std::memcpy(&w, d, n);
+	h = (h ^ w) * 0x9e3779b97f4a7c15ull;
+	return h ^ h >> 29;
+}
+
+// rep receives for every entry of the list the first entry with the same bytes, which are quantized already. The rows are
+// hashed in a first loop, which has no dependencies between them; an open addressing table finds the equal ones. Entries
+// without bytes stay apart, since coding them costs nothing but their type, which is cheaper than a reference.
+inline void duplicates(mesh::attr::Attr &attr, std::vector<mesh::attridx_t> &rep)
+{
+	mesh::attridx_t n = attr.size();
+	std::size_t nb = attr.fmt().bytes();
+	const unsigned char *d = attr.data();
+	if (nb == 0) {
+		rep.resize(n);
+		for (mesh::attridx_t i = 0; i < n; ++i) rep[i] = i;
+		return;
+	}
+	std::vector<uint64_t> hash(n);
+	for (mesh::attridx_t i = 0; i < n; ++i) {
+		hash[i] = hash_bytes(d + i * nb, nb);
+	}
+
+	std::size_t mask = 1;
+	while (mask < (std::size_t)n * 2) mask <<= 1;
+	std::vector<mesh::attridx_t> table(mask--, UNSET);
+	rep.resize(n);
+	for (mesh::attridx_t i = 0; i < n; ++i) {
+		std::size_t h = hash[i] & mask;
+		for (; table[h] != UNSET; h = (h + 1) & mask) {
+			mesh::attridx_t j = table[h];
+			if (hash[j] == hash[i] && std::memcmp(d + j * nb, d + i * nb, nb) == 0) break;
+		}
+		if (table[h] == UNSET) table[h] = i;
+		rep[i] = table[h];
+	}
+}
+
 struct GlobalHistory {
 	std::vector<mesh::attridx_t> tidxlist;
 	mesh::attridx_t tidx;
+	std::vector<mesh::attridx_t> rep; // see duplicates(), empty unless equal values are coded as references
 
 	GlobalHistory() : tidx(0)
 	{}
@@ -32,6 +85,16 @@ struct GlobalHistory {
 		tidxlist.resize(size, UNSET);
 	}
 
+	void dedup(mesh::attr::Attr &attr)
+	{
+		duplicates(attr, rep);
+	}
+	// the entry, which stands for the value of idx
+	mesh::attridx_t canon(mesh::attridx_t idx)
+	{
+		return rep.empty() ? idx : rep[idx];
+	}
+
 	void set(mesh::attridx_t idx)
 	{
 		tidxlist[idx] = tidx++;
@@ -51,69 +114,121 @@ struct GlobalHistory {
 		}
 	}
 };
+// Attribute indices of the corners of every vertex, in the order of their insertion. The first two of a vertex are stored
+// inline, the rest in blocks of a shared pool, whose capacities are powers of two. A full block is copied to the end of
+// the pool with twice the capacity, which leaves a gap; vertices with more than two distinct corner values are rare.
 struct LocalHistory {
-	std::vector<std::vector<mesh::attridx_t>> hist; // TODO: this results in a vector<vector<vector<X>>>, reduce this to max 2 containers
+	static const uint32_t NINL = 2;
+	struct Entry {
+		uint32_t n, off; // number of indices; offset of the block of the others in the pool
+		mesh::attridx_t inl[NINL];
+	};
+	std::vector<Entry> hist;
+	std::vector<mesh::attridx_t> pool;
 
 	void resize(mesh::vtxidx_t size)
 	{
-		hist.resize(size);
+		hist.resize(size, Entry{ 0, 0, { UNSET, UNSET } });
 	}
 
 	bool empty(mesh::vtxidx_t v)
 	{
-		return hist[v].empty();
+		return hist[v].n == 0;
+	}
+
+	mesh::attridx_t get(const Entry &h, uint32_t i)
+	{
+		return i < NINL ? h.inl[i] : pool[h.off + i - NINL];
 	}
 
 	mesh::attridx_t insert(mesh::vtxidx_t v, mesh::attridx_t idx)
 	{
-		for (mesh::attridx_t i = 0; i < hist[v].size(); ++i) {
-			if (hist[v][i] == idx) return hist[v].size() - 1 - i;
+		Entry &h = hist[v];
+		for (uint32_t i = 0; i < h.n; ++i) {
+			if (get(h, i) == idx) return h.n - 1 - i;
+		}
+		if (h.n < NINL) {
+			h.inl[h.n++] = idx;
+			return UNSET;
 		}
-		hist[v].push_back(idx);
+		uint32_t m = h.n - NINL; // entries in the pool
+		if (m == 0 || (m >= NINL && (m & (m - 1)) == 0)) { // block full (or missing): grow to twice its capacity
+			std::size_t off = pool.size();
+			pool.resize(off + (m == 0 ? NINL : m * 2));
+			std::copy(pool.begin() + h.off, pool.begin() + h.off + m, pool.begin() + off);
+			h.off = off;
+		}
+		pool[h.off + m] = idx;
+		++h.n;
 		return UNSET;
 	}
 
 	mesh::attridx_t find(mesh::vtxidx_t v, mesh::attridx_t off)
 	{
-		return hist[v][hist[v].size() - 1 - off];
+		const Entry &h = hist[v];
+		return get(h, h.n - 1 - off);
 	}
 };
 
 // This is why my collegues hate me:
 #define TFAN_IT(CB) \
 do { \
-	mesh::conn::fepair e = ein, t; \
+	mesh::edgeidx_t e = ein, t; \
 	do { \
 		CB(e, r); \
-		t = mesh.conn.twin(e); \
+		t = twin(e); \
 		if (t == e) goto BWD; \
-		e = mesh.conn.enext(t); \
+		e = mesh.conn.hnext<TRI>(t); \
 	} while (e != ein); \
 	return; \
 \
 BWD: \
-	e = mesh.conn.eprev(ein); \
-	t = mesh.conn.twin(e); \
+	e = mesh.conn.hprev<TRI>(ein); \
+	t = twin(e); \
 	if (e == t) return; \
 	e = t; \
 	do { \
 		CB(e, r); \
-		e = mesh.conn.eprev(e); \
-		t = mesh.conn.twin(e); \
+		e = mesh.conn.hprev<TRI>(e); \
+		t = twin(e); \
 		if (e == t) break; \
 		e = t; \
 	} while (e != ein); \
 } while (0)
 
+// TRI selects the specialization for meshes of triangles only, see conn::Conn
+template <bool TRI>
 struct AbsAttrCoder {
 	std::vector<bool> vtx_is_encoded;
 	std::vector<bool> face_is_encoded;
 	int curparal, curneigh, curhist;
 	mesh::Mesh &mesh;
+	// edges whose twins are known to the decoder at this point, NULL if all of them are (see AttrCoder::flush)
+	const std::vector<bool> *linked;
+	// the only list which is coded, -1 for all of them and the regions (see AttrCoder::regions)
+	int list;
 
-	AbsAttrCoder(mesh::Mesh &_mesh) : mesh(_mesh), vtx_is_encoded(_mesh.attrs.num_vtx(), false), face_is_encoded(_mesh.attrs.num_face(), false)
+	AbsAttrCoder(mesh::Mesh &_mesh, int _list = -1) : mesh(_mesh), vtx_is_encoded(_mesh.attrs.num_vtx(), false), face_is_encoded(_mesh.attrs.num_face(), false), linked(NULL), list(_list)
 	{}
 
+	bool skip(mesh::listidx_t l)
+	{
+		return list != -1 && l != list;
+	}
+	// whether the corner binding a is bound to a coded list in any region
+	bool corner_slot(mesh::listidx_t a)
+	{
+		for (mesh::regidx_t r = 0; r < mesh.attrs.num_regs_face(); ++r) {
+			if (a < mesh.attrs.num_bindings_corner_reg(r) && !skip(mesh.attrs.binding_reg_cornerlist(r, a))) return true;
+		}
+		return false;
+	}
+
+	mesh::edgeidx_t twin(mesh::edgeidx_t e)
+	{
+		return linked == NULL || (*linked)[e] ? mesh.conn.htwin(e) : e;
+	}
+
 	void use_paral(mesh::vtxidx_t v0, mesh::vtxidx_t v1, mesh::vtxidx_t vo, mesh::regidx_t r)
 	{
 		if (!vtx_is_encoded[v0] || !vtx_is_encoded[v1] || !vtx_is_encoded[vo]) return;
@@ -122,6 +237,7 @@ struct AbsAttrCoder {
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_vtx_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_vtxlist(r, a);
+			if (skip(l)) continue;
 
 			// fetch values
 			mixing::View d0 = mesh.attrs[l][mesh.attrs.binding_vtx_attr(v0, a)], d1 = mesh.attrs[l][mesh.attrs.binding_vtx_attr(v1, a)], dop = mesh.attrs[l][mesh.attrs.binding_vtx_attr(vo, a)];
@@ -132,8 +248,9 @@ struct AbsAttrCoder {
 		}
 		++curparal;
 	}
-	void use_corner(mesh::conn::fepair e, mesh::regidx_t r)
+	void use_corner(mesh::edgeidx_t h, mesh::regidx_t r)
 	{
+		mesh::conn::fepair e = mesh.conn.fe<TRI>(h);
 		mesh::faceidx_t f = e.f();
 		mesh::ledgeidx_t lv = e.e();
 		if (!face_is_encoded[f]) return;
@@ -142,6 +259,7 @@ struct AbsAttrCoder {
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_corner_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_cornerlist(r, a);
+			if (skip(l)) continue;
 
 			// fetch values
 			mixing::View d0 = mesh.attrs[l][mesh.attrs.binding_corner_attr(f, lv, a)];
@@ -152,29 +270,30 @@ struct AbsAttrCoder {
 		}
 		++curhist;
 	}
-	void paral(mesh::conn::fepair ein, mesh::regidx_t r)
+	void paral(mesh::edgeidx_t ein, mesh::regidx_t r)
 	{
-		mesh::conn::fepair e = ein, e0, e1, t;
-		if (mesh.conn.num_edges(e.f()) == 3) {
-			e = mesh.conn.enext(e);
-			t = mesh.conn.twin(e);
+		mesh::edgeidx_t e = ein, e0, e1, t;
+		mesh::ledgeidx_t ne = mesh.conn.num_edges<TRI>(mesh.conn.hface<TRI>(e));
+		if (ne == 3) {
+			e = mesh.conn.hnext<TRI>(e);
+			t = twin(e);
 			if (t == e) return;
-			e = mesh.conn.enext(mesh.conn.enext(t));
-			use_paral(mesh.conn.org(t), mesh.conn.dest(t), mesh.conn.org(e), r);
+			e = mesh.conn.hnext<TRI>(mesh.conn.hnext<TRI>(t));
+			use_paral(mesh.conn.horg(t), mesh.conn.hdest<TRI>(t), mesh.conn.horg(e), r);
 			return;
 		}
-		e0 = mesh.conn.enext(e);
-		e1 = mesh.conn.eprev(e);
-		use_paral(mesh.conn.org(e0), mesh.conn.org(e1), mesh.conn.dest(e0), r);
-		if (mesh.conn.num_edges(e.f()) > 4) // when the polygon is a pentagon or more, we have two parallelograms
-			use_paral(mesh.conn.org(e0), mesh.conn.org(e1), mesh.conn.org(mesh.conn.eprev(e)), r);
+		e0 = mesh.conn.hnext<TRI>(e);
+		e1 = mesh.conn.hprev<TRI>(e);
+		use_paral(mesh.conn.horg(e0), mesh.conn.horg(e1), mesh.conn.hdest<TRI>(e0), r);
+		if (ne > 4) // when the polygon is a pentagon or more, we have two parallelograms
+			use_paral(mesh.conn.horg(e0), mesh.conn.horg(e1), mesh.conn.horg(mesh.conn.hprev<TRI>(e)), r);
 	}
 
-	void tfan(mesh::conn::fepair ein, mesh::regidx_t r)
+	void tfan(mesh::edgeidx_t ein, mesh::regidx_t r)
 	{
 		TFAN_IT(paral);
 	}
-	void tfan_corner(mesh::conn::fepair ein, mesh::regidx_t r)
+	void tfan_corner(mesh::edgeidx_t ein, mesh::regidx_t r)
 	{
 		TFAN_IT(use_corner);
 	}
@@ -209,8 +328,8 @@ struct AbsAttrCoder {
 	void vtx(mesh::faceidx_t ff, mesh::ledgeidx_t ee)
 	{
 		// TODO: ULONG and LONG must handled seperately: div first add then
-		mesh::conn::fepair e(ff, ee);
-		mesh::vtxidx_t v = mesh.conn.org(e);
+		mesh::edgeidx_t e = mesh.conn.edge<TRI>(mesh::conn::fepair(ff, ee));
+		mesh::vtxidx_t v = mesh.conn.horg(e);
 		mesh::regidx_t r = mesh.attrs.vtx2reg(v);
 
 		curparal = 0;
@@ -220,6 +339,7 @@ struct AbsAttrCoder {
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_vtx_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_vtxlist(r, a);
+			if (skip(l)) continue;
 			get_prediction(l, num_paral);
 		}
 	}
@@ -232,6 +352,7 @@ struct AbsAttrCoder {
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_face_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_facelist(r, a);
+			if (skip(l)) continue;
 
 			// fetch values
 			mixing::View d0 = mesh.attrs[l][mesh.attrs.binding_face_attr(f, a)];
@@ -242,20 +363,20 @@ struct AbsAttrCoder {
 		}
 		++curneigh;
 	}
-	void neighs(mesh::conn::fepair e, mesh::regidx_t r)
+	void neighs(mesh::edgeidx_t e, mesh::regidx_t r)
 	{
-		mesh::conn::fepair cur = e;
+		mesh::edgeidx_t cur = e;
 		do {
 			// use cur
-			mesh::conn::fepair n = mesh.conn.twin(cur);
-			if (n != cur) use_neigh(cur.f(), r);
-			cur = mesh.conn.enext(cur);
+			mesh::edgeidx_t n = twin(cur);
+			if (n != cur) use_neigh(mesh.conn.hface<TRI>(cur), r);
+			cur = mesh.conn.hnext<TRI>(cur);
 		} while (cur != e);
 	}
 	void face(mesh::faceidx_t f, mesh::ledgeidx_t ee)
 	{
 		mesh::regidx_t r = mesh.attrs.face2reg(f);
-		mesh::conn::fepair e(f, ee);
+		mesh::edgeidx_t e = mesh.conn.edge<TRI>(mesh::conn::fepair(f, ee));
 
 		// get neighs
 		curneigh = 0;
@@ -265,6 +386,7 @@ struct AbsAttrCoder {
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_face_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_facelist(r, a);
+			if (skip(l)) continue;
 			get_prediction(l, num_neigh);
 		}
 	}
@@ -272,7 +394,7 @@ struct AbsAttrCoder {
 	void corner(mesh::faceidx_t f, mesh::ledgeidx_t ee) // WARNING: needs to be called AFTER faces
 	{
 		mesh::regidx_t r = mesh.attrs.face2reg(f);
-		mesh::conn::fepair e(f, ee);
+		mesh::edgeidx_t e = mesh.conn.edge<TRI>(mesh::conn::fepair(f, ee));
 
 		// get hist
 		curhist = 0;
@@ -283,13 +405,14 @@ struct AbsAttrCoder {
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_corner_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_cornerlist(r, a);
+			if (skip(l)) continue;
 			get_prediction(l, num_hist);
 		}
 	}
 };
 
-template <typename WR>
-struct AttrCoder : AbsAttrCoder {
+template <typename WR, bool TRI = false>
+struct AttrCoder : AbsAttrCoder<TRI> {
 	mesh::Mesh &mesh;
 	WR &wr;
 	std::vector<GlobalHistory> ghist;
@@ -297,39 +420,73 @@ struct AttrCoder : AbsAttrCoder {
 	std::vector<mesh::conn::fepair> order;
 	std::vector<mesh::conn::fepair> order_f;
 
-	AttrCoder(mesh::Mesh &_mesh, WR &_wr) : mesh(_mesh), wr(_wr), AbsAttrCoder(_mesh), ghist(_mesh.attrs.size()), lhist(mesh.attrs.num_bindings_corner)
+	// Inline mode: the vertices and the face of the current face are coded by flush() as soon as the face is complete,
+	// instead of after the whole connectivity. The predictions only see the twins which the decoder knows at that point,
+	// so the newest vertex waits for the next one: by then the faces which connect it to the cut-border are known.
+	bool inl;
+	std::deque<mesh::conn::fepair> pending;
+	mesh::conn::fepair pending_f;
+	std::vector<mesh::vtxidx_t> *vtxorder; // receives the vertices in the order of the decoder in inline mode
+
+	// dedup: values, which equal an earlier one of their list, are coded as references to it; list: see AbsAttrCoder
+	AttrCoder(mesh::Mesh &_mesh, WR &_wr, bool _inl = false, bool dedup = false, int _list = -1) : AbsAttrCoder<TRI>(_mesh, _list), mesh(_mesh), wr(_wr), ghist(_mesh.attrs.size()), lhist(mesh.attrs.num_bindings_corner), inl(_inl), vtxorder(NULL)
 	{
 		for (mesh::listidx_t i = 0; i < mesh.attrs.size(); ++i) {
+			if (this->skip(i)) continue;
 			ghist[i].resize(mesh.attrs[i].size());
+			if (dedup) ghist[i].dedup(mesh.attrs[i]);
 		}
 		for (mesh::listidx_t i = 0; i < mesh.attrs.num_bindings_corner; ++i) {
-			lhist[i].resize(mesh.attrs.num_vtx());
+			if (this->corner_slot(i)) lhist[i].resize(mesh.attrs.num_vtx());
 		}
 	}
 
 	void vtx(mesh::faceidx_t f, mesh::ledgeidx_t le)
 	{
 		mesh::conn::fepair e(f, le);
-		order.push_back(e);
+		if (inl) pending.push_back(e);
+		else order.push_back(e);
 	}
 	void face(mesh::faceidx_t f, mesh::ledgeidx_t le)
 	{
 		mesh::conn::fepair e(f, le);
-		order_f.push_back(e);
+		if (inl) pending_f = e;
+		else order_f.push_back(e);
+	}
+	void flush()
+	{
+		if (!inl) return;
+		vertices_post(1);
+		face_post(pending_f.f(), pending_f.e());
+		corners_post(pending_f.f(), pending_f.e());
+	}
+	// codes the vertices which are still pending after the traversal
+	void finish()
+	{
+		if (inl) vertices_post(0);
+	}
+	// codes the pending vertices except for the last keep ones
+	void vertices_post(std::size_t keep)
+	{
+		for (; pending.size() > keep; pending.pop_front()) {
+			vtx_post(pending.front().f(), pending.front().e());
+			if (vtxorder != NULL) vtxorder->push_back(mesh.conn.org<TRI>(pending.front()));
+		}
 	}
 
 	void vtx_post(mesh::faceidx_t f, mesh::ledgeidx_t le)
 	{
 		mesh::conn::fepair e(f, le);
-		mesh::vtxidx_t v = mesh.conn.org(e);
+		mesh::vtxidx_t v = mesh.conn.org<TRI>(e);
 		mesh::regidx_t r = mesh.attrs.vtx2reg(v);
 
-		AbsAttrCoder::vtx(f, le);
-		wr.reg_vtx(r);
+		AbsAttrCoder<TRI>::vtx(f, le);
+		if (this->list == -1) wr.reg_vtx(r);
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_vtx_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_vtxlist(r, a);
-			mesh::attridx_t idx = mesh.attrs.binding_vtx_attr(v, a);
+			if (this->skip(l)) continue;
+			mesh::attridx_t idx = ghist[l].canon(mesh.attrs.binding_vtx_attr(v, a));
 
 			mesh::attridx_t tidx = ghist[l].lget_set(idx);
 			if (tidx != UNSET) {
@@ -346,12 +503,13 @@ struct AttrCoder : AbsAttrCoder {
 	{
 		mesh::regidx_t r = mesh.attrs.face2reg(f);
 
-		AbsAttrCoder::face(f, le);
-		wr.reg_face(r);
+		AbsAttrCoder<TRI>::face(f, le);
+		if (this->list == -1) wr.reg_face(r);
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_face_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_facelist(r, a);
-			mesh::attridx_t idx = mesh.attrs.binding_face_attr(f, a);
+			if (this->skip(l)) continue;
+			mesh::attridx_t idx = ghist[l].canon(mesh.attrs.binding_face_attr(f, a));
 
 			mesh::attridx_t tidx = ghist[l].lget_set(idx);
 			if (tidx != UNSET) {
@@ -364,17 +522,28 @@ struct AttrCoder : AbsAttrCoder {
 			wr.attr_data(res, l);
 		}
 	}
+	// the corners of a face, starting with the one of the face
+	void corners_post(mesh::faceidx_t f, mesh::ledgeidx_t le)
+	{
+		int ne = mesh.conn.num_edges<TRI>(f), c = le;
+		do {
+			corner_post(f, c);
+			++c;
+			if (c == ne) c = 0;
+		} while (c != le);
+	}
 	void corner_post(mesh::faceidx_t f, mesh::ledgeidx_t le)
 	{
 		mesh::regidx_t r = mesh.attrs.face2reg(f);
 
-		AbsAttrCoder::corner(f, le);
+		AbsAttrCoder<TRI>::corner(f, le);
 
 		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_corner_reg(r); ++a) {
 			mesh::listidx_t l = mesh.attrs.binding_reg_cornerlist(r, a);
-			mesh::attridx_t idx = mesh.attrs.binding_corner_attr(f, le, a);
+			if (this->skip(l)) continue;
+			mesh::attridx_t idx = ghist[l].canon(mesh.attrs.binding_corner_attr(f, le, a));
 
-			mesh::attridx_t lidx = lhist[a].insert(mesh.conn.org(f, le), idx);
+			mesh::attridx_t lidx = lhist[a].insert(mesh.conn.org<TRI>(f, le), idx);
 			if (lidx != UNSET) {
 				wr.attr_lhist(lidx, l);
 				continue;
@@ -394,31 +563,44 @@ struct AttrCoder : AbsAttrCoder {
 
 	template <typename P>
 	void encode(P &prog)
+	{
+		encode(prog, order, order_f);
+	}
+	// the order of the vertices and the faces may be the one of another coder
+	template <typename P>
+	void encode(P &prog, const std::vector<mesh::conn::fepair> &order, const std::vector<mesh::conn::fepair> &order_f)
 	{
 		prog.start(order.size());
 		for (int i = 0; i < order.size(); ++i) {
-			mesh::conn::fepair &e = order[i];
+			const mesh::conn::fepair &e = order[i];
 
 			vtx_post(e.f(), e.e());
 			prog(i);
 		}
 		for (int i = 0; i < order_f.size(); ++i) {
-			mesh::conn::fepair &e = order_f[i];
+			const mesh::conn::fepair &e = order_f[i];
 			face_post(e.f(), e.e());
-			int ne = mesh.conn.num_edges(e.f()), c = e.e();
-			do {
-				corner_post(e.f(), c);
-				++c;
-				if (c == ne) c = 0;
-			} while (c != e.e());
+			corners_post(e.f(), e.e());
 		}
 		prog.end();
 	}
+	// Only the regions of the vertices and the faces, which precede the lists, if these are coded into streams of their own.
+	void regions()
+	{
+		for (std::size_t i = 0; i < order.size(); ++i) {
+			wr.reg_vtx(mesh.attrs.vtx2reg(mesh.conn.org<TRI>(order[i])));
+		}
+		for (std::size_t i = 0; i < order_f.size(); ++i) {
+			wr.reg_face(mesh.attrs.face2reg(order_f[i].f()));
+		}
+	}
 };
 
 
-template <typename RD>
-struct AttrDecoder : AbsAttrCoder {
+template <typename RD, bool TRI = false>
+struct AttrDecoder : AbsAttrCoder<TRI> {
+	using AbsAttrCoder<TRI>::mesh;
+
 	RD &rd;
 
 	std::vector<LocalHistory> lhist;
@@ -426,31 +608,57 @@ struct AttrDecoder : AbsAttrCoder {
 
 	mesh::Builder &builder;
 	std::vector<mesh::conn::fepair> order;
+
+	// inline mode, see AttrCoder
+	bool inl;
+	std::deque<mesh::conn::fepair> pending;
+	mesh::faceidx_t pending_f;
 	
-	AttrDecoder(mesh::Builder &_builder, RD &_rd) : builder(_builder), rd(_rd), AbsAttrCoder(_builder.mesh), lhist(mesh.attrs.num_bindings_corner), cur_idx(_builder.mesh.attrs.size(), 0)
+	AttrDecoder(mesh::Builder &_builder, RD &_rd, bool _inl = false, int _list = -1) : AbsAttrCoder<TRI>(_builder.mesh, _list), rd(_rd), lhist(mesh.attrs.num_bindings_corner), cur_idx(_builder.mesh.attrs.size(), 0), builder(_builder), inl(_inl)
 	{
 		for (mesh::listidx_t i = 0; i < mesh.attrs.num_bindings_corner; ++i) {
-			lhist[i].resize(mesh.attrs.num_vtx());
+			if (this->corner_slot(i)) lhist[i].resize(mesh.attrs.num_vtx());
 		}
 	}
 
 	void vtx(mesh::faceidx_t f, mesh::ledgeidx_t le)
 	{
 		mesh::conn::fepair e(f, le);
-		order.push_back(e);
+		if (inl) pending.push_back(e);
+		else order.push_back(e);
+	}
+	void flush()
+	{
+		if (!inl) return;
+		vertices_post(1);
+		face_post(pending_f, 0);
+		corners_post(pending_f);
+	}
+	// see AttrCoder::finish
+	void finish()
+	{
+		if (inl) vertices_post(0);
+	}
+	// codes the pending vertices except for the last keep ones
+	void vertices_post(std::size_t keep)
+	{
+		for (; pending.size() > keep; pending.pop_front()) {
+			vtx_post(pending.front().f(), pending.front().e());
+		}
 	}
 
 	void vtx_post(mesh::faceidx_t f, mesh::ledgeidx_t le)
 	{
 		mesh::conn::fepair e(f, le);
-		mesh::vtxidx_t v = builder.mesh.conn.org(e);
-		mesh::regidx_t r = rd.reg_vtx();
-		builder.vtx_reg(v, r);
+		mesh::vtxidx_t v = builder.mesh.conn.org<TRI>(e);
+		mesh::regidx_t r = this->list == -1 ? rd.reg_vtx() : mesh.attrs.vtx2reg(v);
+		if (this->list == -1) builder.vtx_reg(v, r);
 
-		AbsAttrCoder::vtx(f, le);
+		AbsAttrCoder<TRI>::vtx(f, le);
 
 		for (mesh::listidx_t a = 0; a < builder.mesh.attrs.num_bindings_vtx_reg(r); ++a) {
 			mesh::listidx_t l = builder.mesh.attrs.binding_reg_vtxlist(r, a);
+			if (this->skip(l)) continue;
 			mesh::attridx_t idx;
 
 			switch (rd.attr_type(l)) {
@@ -469,19 +677,21 @@ struct AttrDecoder : AbsAttrCoder {
 		}
 	}
 
-	void face(mesh::faceidx_t f, mesh::ledgeidx_t le)
+	void face(mesh::faceidx_t f, mesh::ledgeidx_t)
 	{
 		// order is obvious: [ 0 0 ], [ 1 0 ], [ 2 0 ]...
+		pending_f = f;
 	}
 	void face_post(mesh::faceidx_t f, mesh::ledgeidx_t le)
 	{
-		mesh::regidx_t r = rd.reg_face();
-		builder.face_reg(f, r);
+		mesh::regidx_t r = this->list == -1 ? rd.reg_face() : mesh.attrs.face2reg(f);
+		if (this->list == -1) builder.face_reg(f, r);
 
-		AbsAttrCoder::face(f, le);
+		AbsAttrCoder<TRI>::face(f, le);
 
 		for (mesh::listidx_t a = 0; a < builder.mesh.attrs.num_bindings_face_reg(r); ++a) {
 			mesh::listidx_t l = builder.mesh.attrs.binding_reg_facelist(r, a);
+			if (this->skip(l)) continue;
 			mesh::attridx_t idx;
 
 			switch (rd.attr_type(l)) {
@@ -499,14 +709,21 @@ struct AttrDecoder : AbsAttrCoder {
 			builder.bind_face_attr(f, a, idx);
 		}
 	}
+	void corners_post(mesh::faceidx_t f)
+	{
+		for (int c = 0; c < mesh.conn.template num_edges<TRI>(f); ++c) {
+			corner_post(f, c);
+		}
+	}
 	void corner_post(mesh::faceidx_t f, mesh::ledgeidx_t le)
 	{
 		mesh::regidx_t r = mesh.attrs.face2reg(f); // face region has already been read before
 
-		AbsAttrCoder::corner(f, le);
+		AbsAttrCoder<TRI>::corner(f, le);
 
 		for (mesh::listidx_t a = 0; a < builder.mesh.attrs.num_bindings_corner_reg(r); ++a) {
 			mesh::listidx_t l = builder.mesh.attrs.binding_reg_cornerlist(r, a);
+			if (this->skip(l)) continue;
 			mesh::attridx_t idx;
 
 			switch (rd.attr_type(l)) {
@@ -515,14 +732,14 @@ struct AttrDecoder : AbsAttrCoder {
 				rd.attr_data(builder.mesh.attrs[l][idx], l);
 
 				mesh.attrs[l][idx].setq([] (int q, const auto delta, const auto pred) { return pred::decodeDelta(delta, pred, q); }, mesh.attrs[l][idx], mesh.attrs[l].accu()[0]);
-				lhist[a].insert(mesh.conn.org(f, le), idx);
+				lhist[a].insert(mesh.conn.template org<TRI>(f, le), idx);
 				break;
 			case HIST:
 				idx = cur_idx[l] - 1 - rd.attr_ghist(l);
-				lhist[a].insert(mesh.conn.org(f, le), idx);
+				lhist[a].insert(mesh.conn.template org<TRI>(f, le), idx);
 				break;
 			case LHIST:
-				idx = lhist[a].find(mesh.conn.org(f, le), rd.attr_lhist(l));
+				idx = lhist[a].find(mesh.conn.template org<TRI>(f, le), rd.attr_lhist(l));
 				break;
 			}
 
@@ -532,22 +749,35 @@ struct AttrDecoder : AbsAttrCoder {
 
 	template <typename P>
 	void decode(P &prog)
+	{
+		decode(prog, order);
+	}
+	template <typename P>
+	void decode(P &prog, const std::vector<mesh::conn::fepair> &order)
 	{
 		prog.start(order.size());
 		for (int i = 0; i < order.size(); ++i) {
-			mesh::conn::fepair &e = order[i];
+			const mesh::conn::fepair &e = order[i];
 
 			vtx_post(e.f(), e.e());
 			prog(i);
 		}
-		for (int i = 0; i < builder.mesh.attrs.num_face(); ++i) {
+		for (mesh::faceidx_t i = 0; i < (inl ? 0 : builder.mesh.attrs.num_face()); ++i) {
 			face_post(i, 0);
-			for (int c = 0; c < mesh.conn.num_edges(i); ++c) {
-				corner_post(i, c);
-			}
+			corners_post(i);
 		}
 		prog.end();
 	}
+	// see AttrCoder::regions
+	void regions()
+	{
+		for (std::size_t i = 0; i < order.size(); ++i) {
+			builder.vtx_reg(mesh.conn.template org<TRI>(order[i]), rd.reg_vtx());
+		}
+		for (mesh::faceidx_t f = 0; f < builder.mesh.attrs.num_face(); ++f) {
+			builder.face_reg(f, rd.reg_face());
+		}
+	}
 };
 
 }
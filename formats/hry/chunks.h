@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "structs/mesh.h"
+
+namespace hry {
+namespace chunks {
+
+// Chunked files: the faces are split into chunks, which are coded into streams of their own and can be coded concurrently.
+// A chunk is a mesh of its own with the regions and attribute lists of the whole mesh. The header is followed by a directory:
+// for each chunk its sizes, the number of shared vertices and the length of its stream, followed by the shared vertices.
+// A vertex, which has already been decoded by an earlier chunk, is shared: it is stored as its index in the decoding order of
+// the chunk and its index in the merged mesh (LEB128 numbers, the former is delta coded). The vertices which are
+// not shared are numbered in the order of the chunks and their decoding order. The attribute lists of the merged mesh are
+// the concatenation of the lists of the chunks, and the edges between two chunks are merged by their vertices.
+
+// numbers of vertices, faces, edges and of the entries of every attribute list
+struct Sizes {
+	uint32_t nvfe[3];
+	std::vector<uint32_t> attrs;
+
+	Sizes() : nvfe{ 0, 0, 0 }
+	{}
+	Sizes(mesh::Mesh &mesh) : nvfe{ mesh.num_vtx(), mesh.num_face(), mesh.num_edge() }, attrs(mesh.attrs.size())
+	{
+		for (mesh::listidx_t l = 0; l < mesh.attrs.size(); ++l) {
+			attrs[l] = mesh.attrs[l].size();
+		}
+	}
+};
+
+// copies the regions, the bindings of the regions and the attribute lists without their entries
+inline void copy_layout(mesh::Builder &builder, mesh::Mesh &src)
+{
+	for (mesh::regidx_t r = 0; r < src.attrs.num_regs_face(); ++r) {
+		builder.add_face_region(src.attrs.num_bindings_face_reg(r), src.attrs.num_bindings_corner_reg(r));
+		for (mesh::listidx_t a = 0; a < src.attrs.num_bindings_face_reg(r); ++a) {
+			builder.bind_reg_facelist(r, a, src.attrs.binding_reg_facelist(r, a));
+		}
+		for (mesh::listidx_t a = 0; a < src.attrs.num_bindings_corner_reg(r); ++a) {
+			builder.bind_reg_cornerlist(r, a, src.attrs.binding_reg_cornerlist(r, a));
+		}
+	}
+	for (mesh::regidx_t r = 0; r < src.attrs.num_regs_vtx(); ++r) {
+		builder.add_vtx_region(src.attrs.num_bindings_vtx_reg(r));
+		for (mesh::listidx_t a = 0; a < src.attrs.num_bindings_vtx_reg(r); ++a) {
+			builder.bind_reg_vtxlist(r, a, src.attrs.binding_reg_vtxlist(r, a));
+		}
+	}
+	builder.init_bindings(src.attrs.num_bindings_face, src.attrs.num_bindings_vtx, src.attrs.num_bindings_corner);
+
+	for (mesh::listidx_t l = 0; l < src.attrs.size(); ++l) {
+		mesh::listidx_t dl = builder.add_list(src.attrs[l].fmt(), src.attrs[l].interps(), src.attrs[l].target);
+		std::memcpy(builder.mesh.attrs[dl].bounds().data(), src.attrs[l].bounds().data(), src.attrs[l].bounds().bytes());
+	}
+	builder.mesh.faces.have_edges = src.faces.have_edges;
+}
+
+inline void put_uint(std::ostream &os, uint32_t v)
+{
+	for (; v >= 0x80; v >>= 7) os.put((v & 0x7f) | 0x80);
+	os.put(v);
+}
+inline uint32_t get_uint(std::istream &is)
+{
+	uint32_t v = 0;
+	for (int sh = 0; sh < 35; sh += 7) {
+		uint8_t c = is.get();
+		v |= uint32_t(c & 0x7f) << sh;
+		if (!(c & 0x80)) break;
+	}
+	return v;
+}
+
+}
+}
@@ -9,10 +9,38 @@
 
 #pragma once
 
+#include <stdint.h>
+#include <vector>
+
 namespace hry {
 
 // Format version
 static const int VER_MAJ = 0;
-static const int VER_MIN = 1;
+static const int VER_MIN = 11;
+
+// Model groups, which can be switched to power-of-two totals
+enum ModelGroup { CONN_MODELS = 1, ATTR_MODELS = 2 };
+// Models for the components of an attribute
+enum AttrModel { BYTE_MODEL, BIT_MODEL };
+
+// Model selection, which is stored in the header
+struct ModelConfig {
+	uint8_t pow2; // ModelGroup flags
+	bool static_tables; // fixed tables, which are learned in a first pass and stored in front of the code
+	uint8_t prior; // ID of the built-in prior for the initial counts, 0 for none
+	bool inline_attrs; // attributes are coded during the traversal into a stream of their own, see attrcode::AttrCoder
+	bool dedup; // writer only: values, which equal an earlier one of their list, are coded as references to it
+	bool list_streams; // every attribute list is coded into a stream of its own, see writer::encode_streams
+	unsigned int threads; // not stored: threads for coding the streams of the lists, 0 for all cores
+	std::vector<std::vector<uint8_t>> attr_models; // AttrModel per list and component, missing entries are BYTE_MODEL
+
+	ModelConfig() : pow2(0), static_tables(false), prior(0), inline_attrs(false), dedup(false), list_streams(false), threads(1)
+	{}
+
+	AttrModel attr_model(int l, int c) const
+	{
+		return l < (int)attr_models.size() && c < (int)attr_models[l].size() ? (AttrModel)attr_models[l][c] : BYTE_MODEL;
+	}
+};
 
 }
@@ -16,11 +16,17 @@
 namespace hry {
 namespace io {
 
+// M is an instance of HryModels
+template <typename M>
 struct writer {
-	HryModels &models;
-	arith::Encoder<> &coder;
+	typedef typename M::Encoder Encoder;
 
-	writer(HryModels &_models, arith::Encoder<> &_coder) : models(_models), coder(_coder)
+	M &models;
+	Encoder &coder, &acoder; // connectivity and attributes, which share a coder unless they are coded inline
+
+	writer(M &_models, Encoder &_coder) : models(_models), coder(_coder), acoder(_coder)
+	{}
+	writer(M &_models, Encoder &_coder, Encoder &_acoder) : models(_models), coder(_coder), acoder(_acoder)
 	{}
 
 	void order(int i)
@@ -90,29 +96,29 @@ struct writer {
 	void attr_data(mixing::View e, mesh::listidx_t l)
 	{
 		attr_type(DATA, l);
-		models.attr_data[l]->enc(coder, e);
+		models.attrs[l]->data.enc(acoder, e);
 	}
 	void attr_type(AttrType type, mesh::listidx_t l)
 	{
-		models.attr_type[l]->template encode<uint8_t>(coder, type);
+		models.attrs[l]->type.template encode<uint8_t>(acoder, type);
 	}
 	void attr_ghist(uint32_t idx, mesh::listidx_t l)
 	{
 		attr_type(HIST, l);
-		models.attr_ghist[l]->template encode<uint32_t>(coder, idx);
+		models.attrs[l]->ghist.template encode<uint32_t>(acoder, idx);
 	}
 	void attr_lhist(uint16_t idx, mesh::listidx_t l)
 	{
 		attr_type(LHIST, l);
-		models.attr_lhist[l]->template encode<uint16_t>(coder, idx);
+		models.attrs[l]->lhist.template encode<uint16_t>(acoder, idx);
 	}
 	void reg_face(mesh::regidx_t r)
 	{
-		models.conn_regface.template encode<uint16_t>(coder, r);
+		models.conn_regface.template encode<uint16_t>(acoder, r);
 	}
 	void reg_vtx(mesh::regidx_t r)
 	{
-		models.conn_regvtx.template encode<uint16_t>(coder, r);
+		models.conn_regvtx.template encode<uint16_t>(acoder, r);
 	}
 
 private:
@@ -165,11 +171,17 @@ private:
 	}
 };
 
+// M is an instance of HryModels
+template <typename M>
 struct reader {
-	HryModels &models;
-	arith::Decoder<> &coder;
+	typedef typename M::Decoder Decoder;
 
-	reader(HryModels &_models, arith::Decoder<> &_coder) : models(_models), coder(_coder)
+	M &models;
+	Decoder &coder, &acoder; // see writer
+
+	reader(M &_models, Decoder &_coder) : models(_models), coder(_coder), acoder(_coder)
+	{}
+	reader(M &_models, Decoder &_coder, Decoder &_acoder) : models(_models), coder(_coder), acoder(_acoder)
 	{}
 
 	void order(int i)
@@ -206,27 +218,27 @@ struct reader {
 	// Attributes
 	void attr_data(mixing::View e, mesh::listidx_t l)
 	{
-		models.attr_data[l]->dec(coder, e);
+		models.attrs[l]->data.dec(acoder, e);
 	}
 	AttrType attr_type(mesh::listidx_t l)
 	{
-		return (AttrType)models.attr_type[l]->template decode<uint8_t>(coder);
+		return (AttrType)models.attrs[l]->type.template decode<uint8_t>(acoder);
 	}
 	uint32_t attr_ghist(mesh::listidx_t l)
 	{
-		return models.attr_ghist[l]->template decode<uint32_t>(coder);
+		return models.attrs[l]->ghist.template decode<uint32_t>(acoder);
 	}
 	uint16_t attr_lhist(mesh::listidx_t l)
 	{
-		return models.attr_lhist[l]->template decode<uint16_t>(coder);
+		return models.attrs[l]->lhist.template decode<uint16_t>(acoder);
 	}
 	mesh::regidx_t reg_face()
 	{
-		return models.conn_regface.template decode<uint16_t>(coder);
+		return models.conn_regface.template decode<uint16_t>(acoder);
 	}
 	mesh::regidx_t reg_vtx()
 	{
-		return models.conn_regvtx.template decode<uint16_t>(coder);
+		return models.conn_regvtx.template decode<uint16_t>(acoder);
 	}
 };
 
@@ -10,19 +10,26 @@
 #pragma once
 
 #include <vector>
+#include <type_traits>
 
 #include "arith/coder.h"
 #include "arith/model.h"
-#include "arith/stat_adaptive.h"
+#include "arith/arena.h"
+#include "arith/stat_pow2.h"
+#include "arith/stat_block.h"
+#include "arith/stat_small.h"
+#include "arith/stat_static.h"
+#include "common.h"
+#include "prior.h"
 #include "cbm/base.h"
 
 namespace hry {
 
 enum AttrType { DATA, HIST, LHIST };
 
-template <typename TF = uint64_t>
-struct CBMInitModel : arith::Model<TF> {
-	arith::AdaptiveStatisticsModule<> stat;
+template <typename S, typename TF = uint64_t, arith::Backend B = arith::ARITH>
+struct CBMInitModel : arith::Model<CBMInitModel<S, TF, B>, TF, B> {
+	S stat;
 
 	CBMInitModel() : stat(cbm::ILAST + 1)
 	{
@@ -31,14 +38,14 @@ struct CBMInitModel : arith::Model<TF> {
 		}
 	}
 
-	void enc(arith::Encoder<TF> &coder, const unsigned char *s, int n)
+	void enc(arith::Encoder<TF, B> &coder, const unsigned char *s, int n)
 	{
 		// TODO correct cast for s
 		const cbm::INITOP *sc = (const cbm::INITOP*)s;
 		coder(this->stat, *sc);
 		this->stat.inc(*sc);
 	}
-	void dec(arith::Decoder<TF> &coder, unsigned char *s, int n)
+	void dec(arith::Decoder<TF, B> &coder, unsigned char *s, int n)
 	{
 		cbm::INITOP *sc = (cbm::INITOP*)s;
 		*sc = (cbm::INITOP)coder(this->stat);
@@ -46,12 +53,24 @@ struct CBMInitModel : arith::Model<TF> {
 	}
 };
 
-template <int MAXORDER, typename TF = uint64_t>
-struct CBMModel : arith::Model<TF> {
-	arith::AdaptiveStatisticsModule<> stat;
+// Model for the operations which are conditioned on the order of the current gate vertex
+template <typename D, typename TF = uint64_t, arith::Backend B = arith::ARITH>
+struct CBMOrderModel : arith::Model<D, TF, B> {
+	int o;
+
+	void order(int _o)
+	{
+		o = _o;
+	}
+};
+
+template <int MAXORDER, typename TF = uint64_t, arith::Backend B = arith::ARITH>
+struct CBMModel : CBMOrderModel<CBMModel<MAXORDER, TF, B>, TF, B> {
+	arith::SmallStatisticsModule<cbm::LAST + 1> stat;
 	TF c;
 	TF c_newvtx_i[MAXORDER], c_connfwd_i[MAXORDER];
-	int o;
+	// the counts are halved above, rANS maps the totals onto 2^31
+	static const TF CFULL = B == arith::RANS ? TF(1) << 30 : TF(1) << 62;
 
 	CBMModel() : stat(cbm::LAST + 1)
 	{
@@ -66,12 +85,7 @@ struct CBMModel : arith::Model<TF> {
 		}
 	}
 
-	void order(int _o)
-	{
-		o = _o;
-	}
-
-	void enc(arith::Encoder<TF> &coder, const unsigned char *s, int n)
+	void enc(arith::Encoder<TF, B> &coder, const unsigned char *s, int n)
 	{
 		const cbm::OP *sc = (const cbm::OP*)s;
 		this->set_orderfreqs();
@@ -79,7 +93,7 @@ struct CBMModel : arith::Model<TF> {
 		this->inc(*sc);
 	}
 
-	void dec(arith::Decoder<TF> &coder, unsigned char *s, int n)
+	void dec(arith::Decoder<TF, B> &coder, unsigned char *s, int n)
 	{
 		cbm::OP *sc = (cbm::OP*)s;
 		this->set_orderfreqs();
@@ -87,10 +101,24 @@ struct CBMModel : arith::Model<TF> {
 		this->inc(*sc);
 	}
 
+	// adds incr initial observations of op at the order index i
+	void init(int i, cbm::OP op, TF incr)
+	{
+		if (op == cbm::NEWVTX) {
+			c += incr;
+			c_newvtx_i[i] += incr;
+		} else if (op == cbm::CONNFWD) {
+			c += incr;
+			c_connfwd_i[i] += incr;
+		} else {
+			stat.init(op, incr);
+		}
+	}
+
 private:
 	void set_orderfreqs()
 	{
-		int i = order2idx(o);
+		int i = order2idx(this->o);
 		TF newvtx_scaled = c_newvtx_i[i] * c / (c_newvtx_i[i] + c_connfwd_i[i]);
 		TF connfwd_scaled = c - newvtx_scaled;
 
@@ -104,9 +132,9 @@ private:
 		return o < MAXORDER ? o : MAXORDER - 1;
 	}
 
-	void inc(arith::AdaptiveStatisticsModule<>::SymType s)
+	void inc(arith::SmallStatisticsModule<cbm::LAST + 1>::SymType s)
 	{
-		int i = order2idx(o);
+		int i = order2idx(this->o);
 		if (s == cbm::NEWVTX) {
 			++c;
 			++c_newvtx_i[i];
@@ -116,96 +144,184 @@ private:
 		} else {
 			stat.inc(s);
 		}
+		if (c > CFULL) halve();
+	}
+	void halve()
+	{
+		c -= c >> 1;
+		for (int i = 0; i < MAXORDER; ++i) {
+			c_newvtx_i[i] -= c_newvtx_i[i] >> 1;
+			c_connfwd_i[i] -= c_connfwd_i[i] >> 1;
+		}
 	}
 };
 
-template <typename S, typename TF = uint64_t>
-struct ModelVector : std::vector<arith::Model<TF>*>
-{
-	const mixing::Fmt &fmt;
+// Variant of CBMModel for statistics modules S with power-of-two totals. Rescaling the shared table on every order change
+// would need divisions again, therefore every order has a table of its own, which covers all operations.
+template <int MAXORDER, typename S = arith::Pow2StatisticsModule<15, cbm::LAST + 1>, typename TF = uint64_t, arith::Backend B = arith::ARITH>
+struct CBMPow2Model : CBMOrderModel<CBMPow2Model<MAXORDER, S, TF, B>, TF, B> {
+	S stat[MAXORDER];
 
-	ModelVector(const mixing::Fmt &_fmt) : fmt(_fmt)
+	CBMPow2Model()
 	{
-		for (int i = 0; i < fmt.size(); ++i) {
-			arith::Model<TF> *model;
-			switch (fmt.stype(i)) {
-			case mixing::FLOAT:  model = new arith::ModelMult<uint32_t, S, TF>(); break;
-			case mixing::DOUBLE: model = new arith::ModelMult<uint64_t, S, TF>(); break;
-			case mixing::ULONG:  model = new arith::ModelMult<uint64_t, S, TF>(); break;
-			case mixing::LONG:   model = new arith::ModelMult<int64_t,  S, TF>(); break;
-			case mixing::UINT:   model = new arith::ModelMult<uint32_t, S, TF>(); break;
-			case mixing::INT:    model = new arith::ModelMult<int32_t,  S, TF>(); break;
-			case mixing::USHORT: model = new arith::ModelMult<int16_t,  S, TF>(); break;
-			case mixing::SHORT:  model = new arith::ModelMult<uint16_t, S, TF>(); break;
-			case mixing::UCHAR:  model = new arith::ModelMult<int8_t,   S, TF>(); break;
-			case mixing::CHAR:   model = new arith::ModelMult<uint8_t,  S, TF>(); break;
+		for (int o = 0; o < MAXORDER; ++o) {
+			for (int i = cbm::FIRST; i <= cbm::LAST; ++i) {
+				stat[o].init(i);
 			}
-			this->push_back(model);
 		}
 	}
 
-	ModelVector(const ModelVector<S, TF>&) = delete;
-	ModelVector<S, TF> &operator=(const ModelVector<S, TF>&) = delete;
+	void enc(arith::Encoder<TF, B> &coder, const unsigned char *s, int n)
+	{
+		const cbm::OP *sc = (const cbm::OP*)s;
+		S &st = stat[order2idx(this->o)];
+		coder(st, *sc);
+		st.inc(*sc);
+	}
 
-	~ModelVector()
+	void dec(arith::Decoder<TF, B> &coder, unsigned char *s, int n)
 	{
-		for (int i = 0; i < fmt.size(); ++i) {
-			switch (fmt.stype(i)) {
-			case mixing::FLOAT:  delete (arith::ModelMult<uint32_t, S, TF>*)(*this)[i]; break;
-			case mixing::DOUBLE: delete (arith::ModelMult<uint64_t, S, TF>*)(*this)[i]; break;
-			case mixing::ULONG:  delete (arith::ModelMult<uint64_t, S, TF>*)(*this)[i]; break;
-			case mixing::LONG:   delete (arith::ModelMult<int64_t,  S, TF>*)(*this)[i]; break;
-			case mixing::UINT:   delete (arith::ModelMult<uint32_t, S, TF>*)(*this)[i]; break;
-			case mixing::INT:    delete (arith::ModelMult<int32_t,  S, TF>*)(*this)[i]; break;
-			case mixing::USHORT: delete (arith::ModelMult<int16_t,  S, TF>*)(*this)[i]; break;
-			case mixing::SHORT:  delete (arith::ModelMult<uint16_t, S, TF>*)(*this)[i]; break;
-			case mixing::UCHAR:  delete (arith::ModelMult<int8_t,   S, TF>*)(*this)[i]; break;
-			case mixing::CHAR:   delete (arith::ModelMult<uint8_t,  S, TF>*)(*this)[i]; break;
+		cbm::OP *sc = (cbm::OP*)s;
+		S &st = stat[order2idx(this->o)];
+		*sc = (cbm::OP)coder(st);
+		st.inc(*sc);
+	}
+
+	// adds incr initial observations of op at the order index i
+	void init(int i, cbm::OP op, TF incr)
+	{
+		stat[i].init(op, incr);
+	}
+
+private:
+	int order2idx(int o) const
+	{
+		--o;
+		return o < MAXORDER ? o : MAXORDER - 1;
+	}
+};
+
+// Models of the components of an attribute list. The statistics are packed into the arena of HryModels: the byte models
+// of all BYTE_MODEL components are followed by the bit trees of all BIT_MODEL components.
+template <typename S, typename TF = uint64_t, arith::Backend B = arith::ARITH>
+struct ModelVector {
+	struct Component {
+		uint8_t model; // AttrModel
+		uint8_t n; // bytes
+		uint32_t off; // first statistics module or bit tree
+	};
+
+	int nc;
+	uint32_t nbytes;
+	Component *comps;
+	S *bytes;
+	arith::BitTree *trees;
+
+	// l is the index of the attribute list in cfg
+	ModelVector(arith::Arena &arena, const mixing::Fmt &fmt, const ModelConfig &cfg, int l) : nc(fmt.size())
+	{
+		comps = arena.make_array<Component>(nc);
+		uint32_t ntrees = 0;
+		nbytes = 0;
+		for (int i = 0; i < nc; ++i) {
+			comps[i].model = cfg.attr_model(l, i);
+			comps[i].n = fmt.bytes(i);
+			uint32_t &cnt = comps[i].model == BIT_MODEL ? ntrees : nbytes;
+			comps[i].off = cnt;
+			cnt += comps[i].n;
+		}
+
+		bytes = arena.make_array<S>(nbytes);
+		for (uint32_t i = 0; i < nbytes; ++i) {
+			for (int j = 0; j < 256; ++j) {
+				bytes[i].init(j);
 			}
 		}
+		trees = arena.make_array<arith::BitTree>(ntrees);
 	}
 
-	void enc(arith::Encoder<TF> &coder, mixing::View v)
+	ModelVector(const ModelVector<S, TF, B>&) = delete;
+	ModelVector<S, TF, B> &operator=(const ModelVector<S, TF, B>&) = delete;
+
+	// upper bound of the arena space for the constructor
+	static size_t arena_bytes(const mixing::Fmt &fmt, const ModelConfig &cfg, int l)
 	{
+		size_t nbytes = 0, ntrees = 0;
 		for (int i = 0; i < fmt.size(); ++i) {
-			(*this)[i]->enc(coder, v.data(i), v.bytes(i));
+			(cfg.attr_model(l, i) == BIT_MODEL ? ntrees : nbytes) += fmt.bytes(i);
 		}
+		return arith::Arena::bytes<Component>(fmt.size()) + arith::Arena::bytes<S>(nbytes) + arith::Arena::bytes<arith::BitTree>(ntrees);
 	}
 
-	void dec(arith::Decoder<TF> &coder, mixing::View v)
+	void enc(arith::Encoder<TF, B> &coder, mixing::View v)
 	{
-		for (int i = 0; i < fmt.size(); ++i) {
-			(*this)[i]->dec(coder, v.data(i), v.bytes(i));
+		for (int i = 0; i < nc; ++i) {
+			const Component &c = comps[i];
+			if (c.model == BIT_MODEL) arith::enc_bits(coder, trees + c.off, v.data(i), c.n);
+			else arith::enc_bytes(coder, bytes + c.off, v.data(i), c.n);
+		}
+	}
+
+	void dec(arith::Decoder<TF, B> &coder, mixing::View v)
+	{
+		for (int i = 0; i < nc; ++i) {
+			const Component &c = comps[i];
+			if (c.model == BIT_MODEL) arith::dec_bits(coder, trees + c.off, v.data(i), c.n);
+			else arith::dec_bytes(coder, bytes + c.off, v.data(i), c.n);
 		}
 	}
 };
 
+// All models of a mesh. The model groups (CONN_MODELS, ATTR_MODELS) given in POW2 use power-of-two totals, so that the
+// coder does not divide. With STATIC, all multi-symbol models use fixed tables instead, which are learned in a first
+// encoding pass and stored in front of the code (see tables()).
+// The connectivity models are members, the models of the attribute lists are packed into one arena in list order.
+// All models are called without virtual dispatch.
+template <arith::Backend B = arith::ARITH, int POW2 = 0, bool STATIC = false>
 struct HryModels {
-	CBMModel<8> conn_op;
-	CBMInitModel<> conn_iop;
-	arith::ModelMult<uint32_t, arith::AdaptiveStatisticsModule<>> conn_elem;
-	arith::ModelMult<uint16_t, arith::AdaptiveStatisticsModule<>> conn_part;
-	arith::ModelMult<uint32_t, arith::AdaptiveStatisticsModule<>> conn_vert;
-	arith::ModelMult<uint16_t, arith::AdaptiveStatisticsModule<>> conn_numtri;
-	arith::ModelMult<uint16_t, arith::AdaptiveStatisticsModule<>> conn_regface, conn_regvtx;
-
-	std::vector<arith::ModelMult<uint8_t, arith::AdaptiveStatisticsModule<>>*> attr_type;
-	std::vector<arith::ModelMult<uint32_t, arith::AdaptiveStatisticsModule<>>*> attr_ghist;
-	std::vector<arith::ModelMult<uint16_t, arith::AdaptiveStatisticsModule<>>*> attr_lhist;
-	std::vector<ModelVector<arith::AdaptiveStatisticsModule<>>*> attr_data;
-
-	HryModels(mesh::Mesh &mesh) :
-		conn_numtri(false), conn_regface(false), conn_regvtx(false)
-	{
-		for (int i = 0; i < mesh.attrs.size(); ++i) {
-			attr_type.push_back(new arith::ModelMult<uint8_t, arith::AdaptiveStatisticsModule<>>(false));
-			attr_type.back()->init(DATA); attr_type.back()->init(HIST);
-			if (mesh.attrs[i].target == mesh::attr::CORNER) attr_type.back()->init(LHIST);
-			attr_ghist.push_back(new arith::ModelMult<uint32_t, arith::AdaptiveStatisticsModule<>>());
-			attr_lhist.push_back(new arith::ModelMult<uint16_t, arith::AdaptiveStatisticsModule<>>());
-			attr_data.push_back(new ModelVector<arith::AdaptiveStatisticsModule<>>(mesh.attrs[i].fmt()));
+	typedef arith::Encoder<uint64_t, B> Encoder;
+	typedef arith::Decoder<uint64_t, B> Decoder;
+
+	static const bool CONN_POW2 = (POW2 & CONN_MODELS) != 0, ATTR_POW2 = (POW2 & ATTR_MODELS) != 0;
+	static const int MAXORDER = 8; // orders of the gate vertex, which condition the operations
+	template <bool P, typename T, typename F>
+	using select = typename std::conditional<P, T, F>::type;
+	// fixed table, power-of-two total or adaptive statistics module with up to N symbols
+	template <bool P, int N, typename PS, typename AS>
+	using stat = select<STATIC, arith::StaticStatisticsModule<15, N>, select<P, PS, AS>>;
+
+	typedef stat<CONN_POW2, 256, arith::Pow2StatisticsModule<>, arith::BlockStatisticsModule<>> ConnStat;
+	typedef stat<CONN_POW2, 33, arith::Pow2StatisticsModule<15, 33>, arith::SmallStatisticsModule<33>> ConnBucketStat; // bit lengths of the indices
+	typedef stat<CONN_POW2, cbm::ILAST + 1, arith::Pow2StatisticsModule<15, cbm::ILAST + 1>, arith::SmallStatisticsModule<cbm::ILAST + 1>> ConnInitStat;
+	typedef select<STATIC || CONN_POW2, CBMPow2Model<MAXORDER, stat<true, cbm::LAST + 1, arith::Pow2StatisticsModule<15, cbm::LAST + 1>, void>, uint64_t, B>, CBMModel<MAXORDER, uint64_t, B>> ConnOpModel;
+	typedef stat<ATTR_POW2, 256, arith::Pow2StatisticsModule<>, arith::BlockStatisticsModule<>> AttrStat;
+	typedef stat<ATTR_POW2, LHIST + 1, arith::Pow2StatisticsModule<15, LHIST + 1>, arith::SmallStatisticsModule<LHIST + 1>> AttrTypeStat; // 3 symbols
+
+	// Models of one attribute list
+	struct AttrModels {
+		arith::ModelMult<uint8_t, AttrTypeStat, uint64_t, B> type;
+		arith::ModelMult<uint32_t, AttrStat, uint64_t, B> ghist;
+		arith::ModelMult<uint16_t, AttrStat, uint64_t, B> lhist;
+		ModelVector<AttrStat, uint64_t, B> data;
+
+		AttrModels(arith::Arena &arena, const mesh::attr::Attr &attr, const ModelConfig &cfg, int l) : type(false), data(arena, attr.fmt(), cfg, l)
+		{
+			type.init(DATA); type.init(HIST);
+			if (attr.target == mesh::attr::CORNER) type.init(LHIST);
 		}
+	};
+
+	ConnOpModel conn_op;
+	CBMInitModel<ConnInitStat, uint64_t, B> conn_iop;
+	arith::ModelGamma<uint32_t, ConnBucketStat, uint64_t, B> conn_elem, conn_vert;
+	arith::ModelGamma<uint16_t, ConnBucketStat, uint64_t, B> conn_part;
+	arith::ModelMult<uint16_t, ConnStat, uint64_t, B> conn_numtri, conn_regface, conn_regvtx;
 
+	arith::Arena arena;
+	std::vector<AttrModels*> attrs;
+
+	HryModels(mesh::Mesh &mesh, const ModelConfig &cfg = ModelConfig()) : conn_numtri(false), conn_regface(false), conn_regvtx(false)
+	{
 		for (mesh::Faces::EdgeIterator it = mesh.faces.edge_begin(); it != mesh.faces.edge_end(); ++it) {
 			conn_numtri.init((uint16_t)(*it - 2));
 		}
@@ -215,24 +331,81 @@ struct HryModels {
 		for (int i = 0; i < mesh.attrs.num_regs_vtx(); ++i) {
 			conn_regvtx.init(i);
 		}
+
+		size_t cap = 0;
+		for (mesh::listidx_t i = 0; i < mesh.attrs.size(); ++i) {
+			cap += arith::Arena::bytes<AttrModels>() + ModelVector<AttrStat, uint64_t, B>::arena_bytes(mesh.attrs[i].fmt(), cfg, i);
+		}
+		arena.reserve(cap);
+		for (mesh::listidx_t i = 0; i < mesh.attrs.size(); ++i) {
+			attrs.push_back(arena.template make<AttrModels>(arena, mesh.attrs[i], cfg, i));
+		}
+
+		if (cfg.prior != 0) prior(find_prior(cfg.prior));
 	}
 
 	HryModels(const HryModels&) = delete;
 	HryModels &operator=(const HryModels&) = delete;
 
-	~HryModels()
+	void order(int i)
 	{
-		for (int i = 0; i < attr_data.size(); ++i) {
-			delete attr_type[i];
-			delete attr_ghist[i];
-			delete attr_lhist[i];
-			delete attr_data[i];
+		conn_op.order(i);
+	}
+
+	// calls f for every statistics module with a fixed table, in the order of the stored tables
+	template <typename F>
+	void tables(F f)
+	{
+		for (int i = 0; i < MAXORDER; ++i) f(conn_op.stat[i]);
+		f(conn_iop.stat);
+		f(conn_elem.bucket); f(conn_vert.bucket); f(conn_part.bucket);
+		for (int i = 0; i < 2; ++i) {
+			f(conn_numtri.stats[i]); f(conn_regface.stats[i]); f(conn_regvtx.stats[i]);
+		}
+		for (std::size_t l = 0; l < attrs.size(); ++l) {
+			AttrModels &a = *attrs[l];
+			f(a.type.stats[0]);
+			for (int i = 0; i < 4; ++i) f(a.ghist.stats[i]);
+			for (int i = 0; i < 2; ++i) f(a.lhist.stats[i]);
+			for (uint32_t i = 0; i < a.data.nbytes; ++i) f(a.data.bytes[i]);
 		}
 	}
 
-	void order(int i)
+	// calls f(t, s) for every statistics module s, which has the table t in a prior; the operations are handled by prior()
+	template <typename F>
+	void prior_stats(F f)
 	{
-		conn_op.order(i);
+		f(PRIOR_IOP, conn_iop.stat);
+		f(PRIOR_ELEM, conn_elem.bucket); f(PRIOR_VERT, conn_vert.bucket); f(PRIOR_PART, conn_part.bucket);
+		for (int i = 0; i < 2; ++i) f(PRIOR_NUMTRI + i, conn_numtri.stats[i]);
+		for (std::size_t l = 0; l < attrs.size(); ++l) {
+			AttrModels &a = *attrs[l];
+			f(PRIOR_TYPE, a.type.stats[0]);
+			for (int i = 0; i < 4; ++i) f(PRIOR_GHIST + i, a.ghist.stats[i]);
+			for (int i = 0; i < 2; ++i) f(PRIOR_LHIST + i, a.lhist.stats[i]);
+			for (int c = 0; c < a.data.nc; ++c) {
+				const typename ModelVector<AttrStat, uint64_t, B>::Component &comp = a.data.comps[c];
+				if (comp.model != BYTE_MODEL) continue;
+				for (int i = 0; i < comp.n; ++i) f(prior_data(comp.n, i), a.data.bytes[comp.off + i]);
+			}
+		}
+	}
+
+	// adds the tables of p to the initial counts
+	void prior(const Prior &p)
+	{
+		for (int o = 0; o < MAXORDER; ++o) {
+			for (int i = cbm::FIRST; i <= cbm::LAST; ++i) {
+				uint32_t c = prior_count(p.tables[PRIOR_OP + o][i]);
+				if (c != 0) conn_op.init(o, (cbm::OP)i, c);
+			}
+		}
+		prior_stats([&p] (int t, auto &s) {
+			for (uint32_t i = 0; i < s.n && i < PRIOR_SYMS; ++i) {
+				uint32_t c = prior_count(p.tables[t][i]);
+				if (c != 0) s.init(i, c);
+			}
+		});
 	}
 };
 
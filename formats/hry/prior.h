@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdexcept>
+
+namespace hry {
+
+// Tables of a prior. They do not depend on the layout of the attribute lists: the bytes of all attribute components are
+// pooled by the size of the component type and the position of the byte.
+enum PriorTable {
+	PRIOR_OP = 0, // one table per order of the gate vertex
+	PRIOR_IOP = PRIOR_OP + 8,
+	PRIOR_ELEM, PRIOR_VERT, PRIOR_PART, // bit lengths of the indices
+	PRIOR_NUMTRI, // 2 bytes
+	PRIOR_TYPE = PRIOR_NUMTRI + 2,
+	PRIOR_GHIST, // 4 bytes
+	PRIOR_LHIST = PRIOR_GHIST + 4, // 2 bytes
+	PRIOR_DATA = PRIOR_LHIST + 2, // 1, 2, 4 and 8 bytes for components with 1, 2, 4 and 8 bytes
+	PRIOR_NUM = PRIOR_DATA + 15
+};
+
+static const int PRIOR_SYMS = 256;
+static const int PRIOR_BITS = 12; // every table sums up to 2^PRIOR_BITS, or to 0 if it has never been used
+static const int PRIOR_WEIGHT = 256; // number of observations a table stands for
+
+inline int prior_data(int size, int byte)
+{
+	return PRIOR_DATA + size - 1 + byte;
+}
+
+// additional initial count of a symbol with the given frequency in a prior table
+inline uint32_t prior_count(uint16_t f)
+{
+	return (uint32_t)f * PRIOR_WEIGHT >> PRIOR_BITS;
+}
+
+struct Prior {
+	uint8_t id;
+	const char *name;
+	const uint16_t (*tables)[PRIOR_SYMS];
+};
+
+}
+
+#include "priors.h"
+
+namespace hry {
+
+// built-in prior with the given ID, which is stored in the header (0 stands for no prior)
+inline const Prior &find_prior(uint8_t id)
+{
+	const Prior *priors = builtin_priors();
+	for (int i = 0; priors[i].id != 0; ++i) {
+		if (priors[i].id == id) return priors[i];
+	}
+	throw std::runtime_error("Unknown prior");
+}
+
+}
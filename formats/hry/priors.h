@@ -0,0 +1,27 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include "prior.h"
+#include "priors/generic.h"
+
+namespace hry {
+
+// Built-in priors, which are generated with harry-prior. The IDs are stored in the header, so they must never be reused.
+inline const Prior *builtin_priors()
+{
+	static const Prior priors[] = {
+		{ 1, "generic", prior_generic() },
+		{ 0, NULL, NULL }
+	};
+	return priors;
+}
+
+}
@@ -9,21 +9,28 @@
 
 #include <stdexcept>
 #include <string>
+#include <type_traits>
+#include <cstring>
 
 #include "reader.h"
 
 #include "common.h"
+#include "chunks.h"
 #include "attrcode.h"
 #include "io.h"
 #include "cbm/decoder.h"
 #include "utils/endian.h"
+#include "utils/parallel.h"
 #include "utils/progress.h"
 
 namespace hry {
 namespace reader {
 
+// TRI selects the specialization for meshes of triangles only, see conn::Conn
+template <bool TRI>
 struct MeshHandle {
-	typedef mesh::conn::fepair Edge;
+	typedef mesh::edgeidx_t Edge;
+	static const bool tri = TRI;
 
 	mesh::Mesh &mesh;
 
@@ -41,19 +48,19 @@ struct MeshHandle {
 	}
 	inline Edge edge(mesh::faceidx_t f)
 	{
-		return Edge(f, 0);
+		return mesh.conn.edge<TRI>(mesh::conn::fepair(f, 0));
 	}
 	inline void set_org(Edge e, mesh::vtxidx_t o)
 	{
-		mesh.conn.set_org(e, o);
+		mesh.conn.hset_org(e, o);
 	}
 	inline Edge next(Edge e)
 	{
-		return mesh.conn.enext(e);
+		return mesh.conn.hnext<TRI>(e);
 	}
 	inline void merge(Edge a, Edge b)
 	{
-		mesh.conn.fmerge(a, b);
+		mesh.conn.hmerge(a, b);
 	}
 };
 
@@ -74,9 +81,29 @@ struct HeaderReader {
 		if (ver[0] == 0 && ver[1] != VER_MIN) throw std::runtime_error(std::string("File format version ") + std::to_string(ver[0]) + "." + std::to_string(ver[1]) + " incompatible to decoder format version " + std::to_string(VER_MAJ) + "." + std::to_string(VER_MIN) + " (All 0.x-versions are incompatible to each other)");
 	}
 
-	void read_syntax(mesh::Builder &builder)
+	arith::Backend read_syntax(mesh::Builder &builder, ModelConfig &cfg, uint32_t &nchunks)
 	{
 		check_magic();
+		uint8_t backend;
+		is.read((char*)&backend, 1);
+		if (backend > arith::RANS) throw std::runtime_error("Unknown entropy coder backend");
+		is.read((char*)&cfg.pow2, 1);
+		if (cfg.pow2 > (CONN_MODELS | ATTR_MODELS)) throw std::runtime_error("Unknown model groups");
+		uint8_t static_tables;
+		is.read((char*)&static_tables, 1);
+		is.read((char*)&cfg.prior, 1);
+		uint8_t inline_attrs;
+		is.read((char*)&inline_attrs, 1);
+		if (inline_attrs > 1) throw std::runtime_error("Invalid model configuration");
+		cfg.inline_attrs = inline_attrs;
+		uint8_t list_streams;
+		is.read((char*)&list_streams, 1);
+		if (list_streams > 1 || (list_streams && inline_attrs)) throw std::runtime_error("Invalid model configuration");
+		cfg.list_streams = list_streams;
+		if (static_tables > 1 || (static_tables && (cfg.pow2 || cfg.prior))) throw std::runtime_error("Invalid model configuration");
+		cfg.static_tables = static_tables;
+		if (cfg.prior) find_prior(cfg.prior);
+		is.read((char*)&nchunks, 4);
 		uint32_t nvfe[3];
 		is.read((char*)nvfe, 3 * 4);
 
@@ -125,6 +152,7 @@ struct HeaderReader {
 		builder.alloc_vtx(nvfe[0]);
 		builder.alloc_face(nvfe[1], nvfe[2]);
 
+		cfg.attr_models.resize(targets.size());
 		for (int i = 0; i < targets.size(); ++i) {
 			uint32_t s = 0;
 			mixing::Fmt fmt, fmt_dequant;
@@ -135,10 +163,13 @@ struct HeaderReader {
 				uint16_t nfmt;
 				is.read((char*)&nfmt, 2);
 				for (int j = 0; j < nfmt; ++j) {
-					uint8_t type, quant;
+					uint8_t type, quant, model;
 					is.read((char*)&type, 1);
 					is.read((char*)&quant, 1);
+					is.read((char*)&model, 1);
+					if (model > BIT_MODEL) throw std::runtime_error("Unknown attribute model");
 					fmt.add((mixing::Type)type, quant);
+					cfg.attr_models[i].push_back(model);
 				}
 
 				uint16_t ninterps;
@@ -173,23 +204,308 @@ struct HeaderReader {
 			is.read((char*)&ntri, 2);
 			builder.seen_edge(ntri);
 		}
+
+		return (arith::Backend)backend;
+	}
+
+	// directory entry of a chunk, see chunks.h
+	uint32_t read_chunk(mesh::Mesh &mesh, chunks::Sizes &sizes, std::vector<std::pair<mesh::vtxidx_t, mesh::vtxidx_t>> &shared)
+	{
+		is.read((char*)sizes.nvfe, 3 * 4);
+		sizes.attrs.assign(mesh.attrs.size(), 0);
+		for (mesh::listidx_t l = 0; l < mesh.attrs.size(); ++l) {
+			if (mesh.attrs[l].target != mesh::attr::NONE) is.read((char*)&sizes.attrs[l], 4);
+		}
+		uint32_t nshared, bytes;
+		is.read((char*)&nshared, 4);
+		is.read((char*)&bytes, 4);
+		if (!is || nshared > sizes.nvfe[0]) throw std::runtime_error("Invalid chunk directory");
+		shared.resize(nshared);
+		mesh::vtxidx_t last = 0;
+		for (uint32_t i = 0; i < nshared; ++i) {
+			shared[i].first = last + chunks::get_uint(is);
+			shared[i].second = chunks::get_uint(is);
+			if ((i != 0 && shared[i].first == last) || shared[i].first >= sizes.nvfe[0]) throw std::runtime_error("Invalid chunk directory");
+			last = shared[i].first;
+		}
+		return bytes;
 	}
 };
 
-void read(std::istream &is, mesh::Mesh &mesh)
+// the tables of static models precede the code
+template <typename Models>
+void read_tables(Models &models, arith::memistream &data, std::true_type)
+{
+	models.tables([&data] (auto &s) { s.read(data); });
+}
+template <typename Models>
+void read_tables(Models&, arith::memistream&, std::false_type)
+{}
+
+// the two streams of inline attributes, see writer::encode_inline
+template <typename P, bool TRI, typename Models>
+void decode_inline(Models &models, arith::memistream &data, mesh::Builder &builder)
+{
+	typedef attrcode::AttrDecoder<io::reader<Models>, TRI> AttrDecoder;
+	uint32_t len;
+	if (data.end - data.cur < 4) throw std::runtime_error("Truncated stream");
+	std::memcpy(&len, data.cur, 4);
+	len = le32toh(len);
+	if (len > data.end - data.cur - 4) throw std::runtime_error("Truncated stream");
+	const uint8_t *mid = data.cur + 4 + len;
+	typename Models::Decoder coder(data.cur + 4, mid), acoder(mid, data.end);
+	io::reader<Models> rd(models, coder, acoder);
+	AttrDecoder ac(builder, rd, true);
+	MeshHandle<TRI> meshhandle(builder.mesh);
+	cbm::decode<MeshHandle<TRI>, io::reader<Models>, AttrDecoder, mesh::vtxidx_t, mesh::faceidx_t>(meshhandle, rd, ac);
+	ac.finish();
+}
+
+// the streams of the lists, see writer::encode_streams
+template <typename P, bool TRI, typename Models>
+void decode_streams(Models &models, arith::memistream &data, mesh::Builder &builder, unsigned int threads)
+{
+	typedef attrcode::AttrDecoder<io::reader<Models>, TRI> AttrDecoder;
+	mesh::listidx_t nl = builder.mesh.attrs.size();
+	std::vector<uint32_t> dir(nl + 2);
+	if ((std::size_t)(data.end - data.cur) < dir.size() * 4) throw std::runtime_error("Truncated stream");
+	std::memcpy(dir.data(), data.cur, dir.size() * 4);
+	if (le32toh(dir[0]) != (uint32_t)nl + 1) throw std::runtime_error("Invalid stream directory");
+	std::vector<const uint8_t*> begin(nl + 2);
+	begin[0] = data.cur + dir.size() * 4;
+	for (mesh::listidx_t s = 0; s <= nl; ++s) {
+		uint32_t len = le32toh(dir[s + 1]);
+		if (len > (std::size_t)(data.end - begin[s])) throw std::runtime_error("Truncated stream");
+		begin[s + 1] = begin[s] + len;
+	}
+
+	typename Models::Decoder coder(begin[0], begin[1]);
+	io::reader<Models> rd(models, coder);
+	AttrDecoder ac(builder, rd);
+	MeshHandle<TRI> meshhandle(builder.mesh);
+	cbm::decode<MeshHandle<TRI>, io::reader<Models>, AttrDecoder, mesh::vtxidx_t, mesh::faceidx_t>(meshhandle, rd, ac);
+	ac.regions();
+
+	parallel::for_each(nl, threads, [&] (std::size_t l) {
+		typename Models::Decoder lcoder(begin[l + 1], begin[l + 2]);
+		io::reader<Models> lrd(models, coder, lcoder);
+		AttrDecoder lac(builder, lrd, false, l);
+		progress::voidhandle prog;
+		lac.decode(prog, ac.order);
+	});
+}
+
+template <typename P, bool TRI, typename Models>
+void decode(Models &models, arith::memistream &data, mesh::Builder &builder, const ModelConfig &cfg)
+{
+	if (cfg.inline_attrs) {
+		decode_inline<P, TRI>(models, data, builder);
+		return;
+	}
+	if (cfg.list_streams) {
+		decode_streams<P, TRI>(models, data, builder, cfg.threads);
+		return;
+	}
+	typedef attrcode::AttrDecoder<io::reader<Models>, TRI> AttrDecoder;
+	typename Models::Decoder coder(data.cur, data.end);
+	io::reader<Models> rd(models, coder);
+	AttrDecoder ac(builder, rd);
+	MeshHandle<TRI> meshhandle(builder.mesh);
+	cbm::decode<MeshHandle<TRI>, io::reader<Models>, AttrDecoder, mesh::vtxidx_t, mesh::faceidx_t>(meshhandle, rd, ac);
+	P proga;
+	ac.decode(proga);
+}
+
+// P is the progress handle
+template <typename P, arith::Backend B, int POW2, bool STATIC>
+void decompress(arith::memistream &data, mesh::Builder &builder, const ModelConfig &cfg)
+{
+	typedef HryModels<B, POW2, STATIC> Models;
+	Models models(builder.mesh, cfg);
+	read_tables(models, data, std::integral_constant<bool, STATIC>());
+	if (builder.mesh.faces.only_triangles()) decode<P, true>(models, data, builder, cfg);
+	else decode<P, false>(models, data, builder, cfg);
+}
+
+// the model groups with power-of-two totals are template arguments of the models
+template <typename P, arith::Backend B>
+void decompress(arith::memistream &data, mesh::Builder &builder, const ModelConfig &cfg)
+{
+	if (cfg.static_tables) {
+		decompress<P, B, 0, true>(data, builder, cfg);
+		return;
+	}
+	switch (cfg.pow2) {
+	case 0:
+		decompress<P, B, 0, false>(data, builder, cfg);
+		break;
+	case CONN_MODELS:
+		decompress<P, B, CONN_MODELS, false>(data, builder, cfg);
+		break;
+	case ATTR_MODELS:
+		decompress<P, B, ATTR_MODELS, false>(data, builder, cfg);
+		break;
+	case CONN_MODELS | ATTR_MODELS:
+		decompress<P, B, CONN_MODELS | ATTR_MODELS, false>(data, builder, cfg);
+		break;
+	}
+}
+
+template <typename P>
+void decompress(arith::memistream &data, mesh::Builder &builder, arith::Backend backend, const ModelConfig &cfg)
+{
+	switch (backend) {
+	case arith::ARITH:
+		decompress<P, arith::ARITH>(data, builder, cfg);
+		break;
+	case arith::RANGE:
+		decompress<P, arith::RANGE>(data, builder, cfg);
+		break;
+	case arith::RANS:
+		decompress<P, arith::RANS>(data, builder, cfg);
+		break;
+	}
+}
+
+// offsets of a chunk in the merged mesh
+struct ChunkOffsets {
+	mesh::faceidx_t face;
+	mesh::edgeidx_t edge;
+	mesh::vtxidx_t vtx; // first vertex which is not shared
+	std::vector<mesh::attridx_t> attrs;
+};
+
+// copies a decoded chunk into its place in the merged mesh
+void merge(mesh::Mesh &mesh, mesh::Mesh &chunk, const ChunkOffsets &off, const std::vector<std::pair<mesh::vtxidx_t, mesh::vtxidx_t>> &shared)
+{
+	std::vector<mesh::vtxidx_t> vmap(chunk.num_vtx());
+	mesh::vtxidx_t next = off.vtx;
+	for (mesh::vtxidx_t v = 0, s = 0; v < vmap.size(); ++v) {
+		vmap[v] = s < shared.size() && shared[s].first == v ? shared[s++].second : next++;
+	}
+
+	for (mesh::faceidx_t f = 0; f < chunk.num_face() && !mesh.faces.offsets.empty(); ++f) {
+		mesh.faces.offsets[off.face + f + 1] = off.edge + chunk.faces.off(f + 1);
+	}
+	for (mesh::edgeidx_t e = 0; e < chunk.num_edge(); ++e) {
+		mesh::conn::Conn::edgeorg &eo = mesh.conn.edges[off.edge + e], &ceo = chunk.conn.edges[e];
+		eo.org = vmap[ceo.org];
+		eo.twin = off.edge + ceo.twin;
+	}
+	for (mesh::edgeidx_t e = 0; e < chunk.num_edge() && !mesh.conn.edgeface.empty(); ++e) {
+		mesh.conn.edgeface[off.edge + e] = off.face + chunk.conn.hface(e);
+	}
+
+	mesh::attr::Attrs &a = mesh.attrs, &ca = chunk.attrs;
+	for (mesh::listidx_t l = 0; l < ca.size(); ++l) {
+		std::size_t bytes = ca[l].fmt().bytes();
+		std::memcpy(a[l].data() + off.attrs[l] * bytes, ca[l].data(), ca[l].size() * bytes);
+	}
+	for (mesh::vtxidx_t v = 0; v < vmap.size(); ++v) {
+		if (vmap[v] < off.vtx) continue; // shared, bound by an earlier chunk
+		mesh::regidx_t r = ca.vtx2reg(v);
+		a.vtx_regs[vmap[v]] = r;
+		for (mesh::listidx_t i = 0; i < ca.num_bindings_vtx_reg(r); ++i) {
+			a.binding_vtx_attr(vmap[v], i) = ca.binding_vtx_attr(v, i) + off.attrs[ca.binding_reg_vtxlist(r, i)];
+		}
+	}
+	for (mesh::faceidx_t f = 0; f < chunk.num_face(); ++f) {
+		mesh::regidx_t r = ca.face2reg(f);
+		a.face_regs[off.face + f] = r;
+		for (mesh::listidx_t i = 0; i < ca.num_bindings_face_reg(r); ++i) {
+			a.binding_face_attr(off.face + f, i) = ca.binding_face_attr(f, i) + off.attrs[ca.binding_reg_facelist(r, i)];
+		}
+		for (mesh::ledgeidx_t c = 0; c < chunk.conn.num_edges(f); ++c) {
+			for (mesh::listidx_t i = 0; i < ca.num_bindings_corner_reg(r); ++i) {
+				a.bindings_corner_attr[(off.edge + chunk.faces.off(f) + c) * a.num_bindings_corner + i] = ca.binding_corner_attr(f, c, i) + off.attrs[ca.binding_reg_cornerlist(r, i)];
+			}
+		}
+	}
+}
+
+// see chunks.h
+void read_chunked(HeaderReader &hr, mesh::Builder &builder, arith::Backend backend, const ModelConfig &cfg, uint32_t n, unsigned int threads)
+{
+	mesh::Mesh &mesh = builder.mesh;
+	std::vector<chunks::Sizes> sizes(n);
+	std::vector<std::vector<std::pair<mesh::vtxidx_t, mesh::vtxidx_t>>> shared(n);
+	std::vector<ChunkOffsets> offs(n + 1);
+	std::vector<std::size_t> code(n + 1, 0);
+	offs[0] = ChunkOffsets{ 0, 0, 0, std::vector<mesh::attridx_t>(mesh.attrs.size(), 0) };
+	for (uint32_t c = 0; c < n; ++c) {
+		code[c + 1] = code[c] + hr.read_chunk(mesh, sizes[c], shared[c]);
+		offs[c + 1] = offs[c];
+		offs[c + 1].face += sizes[c].nvfe[1];
+		offs[c + 1].edge += sizes[c].nvfe[2];
+		offs[c + 1].vtx += sizes[c].nvfe[0] - shared[c].size();
+		for (mesh::listidx_t l = 0; l < mesh.attrs.size(); ++l) {
+			offs[c + 1].attrs[l] += sizes[c].attrs[l];
+		}
+		for (std::size_t s = 0; s < shared[c].size(); ++s) {
+			if (shared[c][s].second >= offs[c].vtx) throw std::runtime_error("Invalid chunk directory");
+		}
+	}
+	if (offs[n].face != mesh.num_face() || offs[n].vtx != mesh.num_vtx() || mesh.attrs.bindings_corner_attr.size() != (std::size_t)offs[n].edge * mesh.attrs.num_bindings_corner) throw std::runtime_error("Invalid chunk directory");
+	for (mesh::listidx_t l = 0; l < mesh.attrs.size(); ++l) {
+		if (offs[n].attrs[l] != mesh.attrs[l].size()) throw std::runtime_error("Invalid chunk directory");
+	}
+	arith::memistream data(hr.is);
+	if ((std::size_t)(data.end - data.cur) < code[n]) throw std::runtime_error("Truncated chunk");
+
+	mesh.conn.resize(offs[n].face, offs[n].edge);
+	std::vector<mesh::faceidx_t> ntri(n);
+	parallel::for_each(n, threads, [&] (std::size_t c) {
+		mesh::Mesh chunk;
+		mesh::Builder cb(chunk);
+		chunks::copy_layout(cb, mesh);
+		cb.alloc_vtx(sizes[c].nvfe[0]);
+		cb.alloc_face(sizes[c].nvfe[1], sizes[c].nvfe[2]);
+		for (mesh::listidx_t l = 0; l < chunk.attrs.size(); ++l) {
+			cb.alloc_attr(l, sizes[c].attrs[l]);
+		}
+		arith::memistream cdata(data.cur + code[c], data.cur + code[c + 1]);
+		decompress<progress::voidhandle>(cdata, cb, backend, cfg);
+		if (chunk.faces.size() != sizes[c].nvfe[1] || chunk.faces.size_edge() != sizes[c].nvfe[2]) throw std::runtime_error("Invalid chunk");
+		merge(mesh, chunk, offs[c], shared[c]);
+		ntri[c] = chunk.conn.num_tri();
+	});
+	mesh.conn.mnum_vtx = offs[n].vtx;
+	mesh.conn.mnum_tri = 0;
+	for (uint32_t c = 0; c < n; ++c) mesh.conn.mnum_tri += ntri[c];
+
+	// the edges between two chunks are borders of both, their vertices are shared
+	std::vector<bool> is_shared(offs[n].vtx, false);
+	for (uint32_t c = 0; c < n; ++c) {
+		for (std::size_t s = 0; s < shared[c].size(); ++s) is_shared[shared[c][s].second] = true;
+	}
+	mesh::conn::Builder::edgemap em;
+	for (mesh::edgeidx_t a = 0; a < mesh.faces.size_edge(); ++a) {
+		mesh::vtxidx_t o = mesh.conn.horg(a), d = mesh.conn.hdest(a);
+		if (mesh.conn.htwin(a) != a || !is_shared[o] || !is_shared[d]) continue;
+		mesh::conn::Builder::edgemap::iterator t = em.find(mesh::conn::Builder::edgemap_e(d, o));
+		if (t != em.end()) {
+			mesh.conn.hmerge(t->second, a);
+			em.erase(t);
+		} else {
+			em.insert(std::make_pair(mesh::conn::Builder::edgemap_e(o, d), a));
+		}
+	}
+}
+
+void read(std::istream &is, mesh::Mesh &mesh, unsigned int threads)
 {
 	mesh::Builder builder(mesh);
 	HeaderReader hr(is);
-	hr.read_syntax(builder);
-
-	arith::Decoder<> coder(is);
-	HryModels models(builder.mesh);
-	io::reader rd(models, coder);
-	attrcode::AttrDecoder<io::reader> ac(builder, rd);
-	MeshHandle meshhandle(mesh);
-	cbm::decode<MeshHandle, io::reader, attrcode::AttrDecoder<io::reader>, mesh::vtxidx_t, mesh::faceidx_t>(meshhandle, rd, ac);
-	progress::handle proga;
-	ac.decode(proga);
+	ModelConfig cfg;
+	uint32_t nchunks;
+	arith::Backend backend = hr.read_syntax(builder, cfg, nchunks);
+	if (nchunks != 0) {
+		read_chunked(hr, builder, backend, cfg, nchunks, threads);
+		return;
+	}
+	arith::memistream data(is); // the coded data is decoded from memory
+	cfg.threads = threads; // for the streams of the lists
+	decompress<progress::handle>(data, builder, backend, cfg);
 }
 
 }
@@ -16,7 +16,8 @@
 namespace hry {
 namespace reader {
 
-void read(std::istream &is, mesh::Mesh &mesh);
+// chunked files are decoded with the given number of threads (0 for all cores)
+void read(std::istream &is, mesh::Mesh &mesh, unsigned int threads = 0);
 
 }
 }
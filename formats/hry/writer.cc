@@ -7,30 +7,43 @@
  * of the BSD 3-Clause license. See the LICENSE.txt file for details.
  */
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
 #include "writer.h"
 
 #include "common.h"
+#include "chunks.h"
 #include "attrcode.h"
 #include "io.h"
 #include "cbm/encoder.h"
+#include "structs/partition.h"
 #include "utils/endian.h"
+#include "utils/parallel.h"
 #include "utils/progress.h"
 
 namespace hry {
 namespace writer {
 
+// TRI selects the specialization for meshes of triangles only, see conn::Conn
+template <bool TRI>
 struct MeshHandle {
-	typedef mesh::conn::fepair Edge;
+	typedef mesh::edgeidx_t Edge;
+	static const bool tri = TRI;
 
-	std::unordered_set<mesh::faceidx_t> remaining_faces;
+	// faces which have not been encoded yet; all faces before the cursor are done
+	std::vector<bool> remaining_faces;
+	mesh::faceidx_t cursor, num_remaining;
 	mesh::Mesh &mesh;
+	std::vector<bool> linked; // edges which the decoder has merged, only tracked for inline attributes
 
-	inline MeshHandle(mesh::Mesh &_mesh) : mesh(_mesh)
-	{
-		for (mesh::faceidx_t i = 0; i < mesh.num_face(); ++i) {
-			remaining_faces.insert(i);
-		}
-	}
+	inline MeshHandle(mesh::Mesh &_mesh) : remaining_faces(_mesh.num_face(), true), cursor(0), num_remaining(_mesh.num_face()), mesh(_mesh)
+	{}
 
 	mesh::vtxidx_t num_vtx()
 	{
@@ -39,49 +52,58 @@ struct MeshHandle {
 
 	inline Edge choose_tri()
 	{
-		mesh::faceidx_t f = remaining_faces.find(0) == remaining_faces.end() ? *remaining_faces.begin() : 0;
-		Edge a = mesh::conn::fepair(f, 0);
-		remaining_faces.erase(f);
+		while (!remaining_faces[cursor]) ++cursor;
+		Edge a = mesh.conn.edge<TRI>(mesh::conn::fepair(cursor, 0));
+		remaining_faces[cursor] = false;
+		--num_remaining;
 		return a;
 	}
 
 	inline Edge choose_twin(Edge i, bool &success)
 	{
-		mesh::conn::fepair a = mesh.conn.twin(i);
+		Edge a = twin(i);
 		success = true;
-		if (a == i || remaining_faces.find(a.f()) == remaining_faces.end()) {
+		if (a == i || !remaining_faces[face(a)]) {
 			success = false;
 			return Edge();
 		}
-		remaining_faces.erase(a.f());
+		remaining_faces[face(a)] = false;
+		--num_remaining;
 		return a;
 	}
 
 	inline bool empty()
 	{
-		return remaining_faces.empty();
+		return num_remaining == 0;
 	}
 
 	inline mesh::vtxidx_t org(Edge e)
 	{
-		return mesh.conn.org(e);
+		return mesh.conn.horg(e);
 	}
 	inline Edge next(Edge e)
 	{
-		return mesh.conn.enext(e);
+		return mesh.conn.hnext<TRI>(e);
 	}
 	inline Edge twin(Edge e)
 	{
-		return mesh.conn.twin(e);
+		return mesh.conn.htwin(e);
 	}
 	inline void merge(Edge a, Edge b)
 	{
-		mesh.conn.fmerge(a, b);
+		mesh.conn.hmerge(a, b);
 	}
 	inline void split(Edge e)
 	{
 		merge(e, e);
 	}
+	// the decoder merges a and b at this point
+	inline void link(Edge a, Edge b)
+	{
+		if (linked.empty()) return;
+		merge(a, b);
+		linked[a] = linked[b] = true;
+	}
 	bool border(Edge e)
 	{
 		return twin(e) == e;
@@ -89,20 +111,21 @@ struct MeshHandle {
 
 	mesh::ledgeidx_t num_edges(mesh::faceidx_t f)
 	{
-		return mesh.conn.num_edges(f);
+		return mesh.conn.num_edges<TRI>(f);
 	}
 	mesh::faceidx_t face(Edge e)
 	{
-		return mesh.conn.face(e);
+		return mesh.conn.hface<TRI>(e);
 	}
 	mesh::ledgeidx_t edge(Edge e)
 	{
-		return e.e();
+		return mesh.conn.fe<TRI>(e).e();
 	}
 };
 
 struct HeaderWriter {
 	std::ostream &os;
+	std::vector<bool> seen_attrs;
 
 	HeaderWriter(std::ostream &_os) : os(_os)
 	{}
@@ -115,14 +138,16 @@ struct HeaderWriter {
 		os.write((char*)ver, 2);
 	}
 
-	void write_syntax(mesh::Mesh &mesh)
+	void write_syntax(mesh::Mesh &mesh, const Options &opts, const chunks::Sizes &sizes, uint32_t nchunks)
 	{
 		write_magic();
-		uint32_t nvfe[] = { mesh.num_vtx(), mesh.num_face(), mesh.num_edge() };
-		os.write((const char*)nvfe, 3 * 4);
+		uint8_t backend[] = { (uint8_t)opts.backend, opts.models.pow2, opts.models.static_tables, opts.models.prior, opts.models.inline_attrs, opts.models.list_streams };
+		os.write((const char*)backend, 6);
+		os.write((const char*)&nchunks, 4);
+		os.write((const char*)sizes.nvfe, 3 * 4);
 
 		// write reg bindings
-		std::vector<bool> seen_attrs(mesh.attrs.size(), false);
+		seen_attrs.assign(mesh.attrs.size(), false);
 
 		uint16_t nrfv[] = { mesh.attrs.num_regs_face(), mesh.attrs.num_regs_vtx() };
 		os.write((const char*)nrfv, 2 * 2);
@@ -153,16 +178,17 @@ struct HeaderWriter {
 		// write attribute meta
 		for (int i = 0; i < seen_attrs.size(); ++i) {
 			if (!seen_attrs[i]) continue;
-			uint32_t s = mesh.attrs[i].size();
+			uint32_t s = sizes.attrs[i];
 			os.write((char*)&s, 4);
 
 			const mixing::Fmt &fmt = mesh.attrs[i].fmt();
 			uint16_t nfmt = fmt.size();
 			os.write((const char*)&nfmt, 2);
 			for (int j = 0; j < nfmt; ++j) {
-				uint8_t type = fmt.type(j), quant = fmt.quant(j);
+				uint8_t type = fmt.type(j), quant = fmt.quant(j), model = opts.models.attr_model(i, j);
 				os.write((const char*)&type, 1);
 				os.write((const char*)&quant, 1);
+				os.write((const char*)&model, 1);
 			}
 
 			const mixing::Interps &interps = mesh.attrs[i].interps();
@@ -195,27 +221,623 @@ struct HeaderWriter {
 		}
 	}
 
+	// directory entry of a chunk, see chunks.h
+	void write_chunk(const chunks::Sizes &sizes, const std::vector<std::pair<mesh::vtxidx_t, mesh::vtxidx_t>> &shared, uint32_t bytes)
+	{
+		os.write((const char*)sizes.nvfe, 3 * 4);
+		for (std::size_t i = 0; i < seen_attrs.size(); ++i) {
+			if (seen_attrs[i]) os.write((const char*)&sizes.attrs[i], 4);
+		}
+		uint32_t nshared = shared.size();
+		os.write((const char*)&nshared, 4);
+		os.write((const char*)&bytes, 4);
+		mesh::vtxidx_t last = 0;
+		for (std::size_t i = 0; i < shared.size(); ++i) {
+			chunks::put_uint(os, shared[i].first - last);
+			chunks::put_uint(os, shared[i].second);
+			last = shared[i].first;
+		}
+	}
 };
 
-void compress(std::ostream &os, mesh::Mesh &mesh)
+// Inline attributes are coded into a stream of their own, which follows the connectivity: [uint32 length of the
+// connectivity code] [connectivity code] [attribute code]. Both the encoder and the decoder work in a single pass then.
+template <typename P, bool TRI, typename Models>
+void encode_inline(std::vector<uint8_t> &buf, mesh::Mesh &mesh, Models &models, const ModelConfig &cfg, std::vector<mesh::vtxidx_t> *vtxorder)
 {
-	HeaderWriter hw(os);
-	hw.write_syntax(mesh);
-	os.flush();
-	arith::Encoder<> coder(os);
-	HryModels models(mesh);
-	io::writer wr(models, coder);
-	attrcode::AttrCoder<io::writer> ac(mesh, wr);
-	MeshHandle meshhandle(mesh);
-	cbm::encode<MeshHandle, io::writer, attrcode::AttrCoder<io::writer>, mesh::vtxidx_t, mesh::faceidx_t>(meshhandle, wr, ac);
-	progress::handle proga;
+	typedef attrcode::AttrCoder<io::writer<Models>, TRI> AttrCoder;
+	std::size_t off = buf.size();
+	buf.resize(off + 4);
+	std::vector<uint8_t> abuf;
+	typename Models::Encoder coder(buf), acoder(abuf);
+	io::writer<Models> wr(models, coder, acoder);
+	AttrCoder ac(mesh, wr, true, cfg.dedup);
+	MeshHandle<TRI> meshhandle(mesh);
+	meshhandle.linked.resize(mesh.num_edge(), false);
+	ac.linked = &meshhandle.linked;
+	ac.vtxorder = vtxorder;
+	if (vtxorder != NULL) vtxorder->clear();
+	cbm::encode<MeshHandle<TRI>, io::writer<Models>, AttrCoder, mesh::vtxidx_t, mesh::faceidx_t>(meshhandle, wr, ac);
+	ac.finish();
+	coder.flush();
+	acoder.flush();
+
+	uint32_t len = htole32(buf.size() - off - 4);
+	std::memcpy(&buf[off], &len, 4);
+	buf.insert(buf.end(), abuf.begin(), abuf.end());
+}
+
+// Streams of the lists: the connectivity and the regions are coded into the first stream, every attribute list into a stream
+// of its own, with models of its own. The lists are coded concurrently after the connectivity. The code starts with a
+// directory: the number of streams and their lengths (uint32 LE).
+template <typename P, bool TRI, typename Models>
+void encode_streams(std::vector<uint8_t> &buf, mesh::Mesh &mesh, Models &models, const ModelConfig &cfg, std::vector<mesh::vtxidx_t> *vtxorder)
+{
+	typedef attrcode::AttrCoder<io::writer<Models>, TRI> AttrCoder;
+	mesh::listidx_t nl = mesh.attrs.size();
+	std::vector<uint32_t> dir(nl + 2);
+	dir[0] = htole32(nl + 1);
+	std::size_t off = buf.size();
+	buf.resize(off + dir.size() * 4);
+
+	typename Models::Encoder coder(buf);
+	io::writer<Models> wr(models, coder);
+	AttrCoder ac(mesh, wr);
+	MeshHandle<TRI> meshhandle(mesh);
+	cbm::encode<MeshHandle<TRI>, io::writer<Models>, AttrCoder, mesh::vtxidx_t, mesh::faceidx_t>(meshhandle, wr, ac);
+	ac.regions();
+	coder.flush();
+	dir[1] = htole32(buf.size() - off - dir.size() * 4);
+
+	std::vector<std::vector<uint8_t>> code(nl);
+	parallel::for_each(nl, cfg.threads, [&] (std::size_t l) {
+		typename Models::Encoder lcoder(code[l]);
+		io::writer<Models> lwr(models, coder, lcoder);
+		AttrCoder lac(mesh, lwr, false, cfg.dedup, l);
+		progress::voidhandle prog;
+		lac.encode(prog, ac.order, ac.order_f);
+		lcoder.flush();
+	});
+	for (mesh::listidx_t l = 0; l < nl; ++l) {
+		dir[l + 2] = htole32(code[l].size());
+		buf.insert(buf.end(), code[l].begin(), code[l].end());
+		std::vector<uint8_t>().swap(code[l]);
+	}
+	std::memcpy(&buf[off], dir.data(), dir.size() * 4);
+
+	if (vtxorder == NULL) return;
+	vtxorder->resize(ac.order.size());
+	for (std::size_t i = 0; i < ac.order.size(); ++i) {
+		(*vtxorder)[i] = mesh.conn.org<TRI>(ac.order[i]);
+	}
+}
+
+// P is the progress handle; vtxorder receives the vertices in the order in which the decoder numbers them
+template <typename P, bool TRI, typename Models>
+void encode(std::vector<uint8_t> &buf, mesh::Mesh &mesh, Models &models, const ModelConfig &cfg, std::vector<mesh::vtxidx_t> *vtxorder)
+{
+	if (cfg.inline_attrs) {
+		encode_inline<P, TRI>(buf, mesh, models, cfg, vtxorder);
+		return;
+	}
+	if (cfg.list_streams) {
+		encode_streams<P, TRI>(buf, mesh, models, cfg, vtxorder);
+		return;
+	}
+	typedef attrcode::AttrCoder<io::writer<Models>, TRI> AttrCoder;
+	typename Models::Encoder coder(buf);
+	io::writer<Models> wr(models, coder);
+	AttrCoder ac(mesh, wr, false, cfg.dedup);
+	MeshHandle<TRI> meshhandle(mesh);
+	cbm::encode<MeshHandle<TRI>, io::writer<Models>, AttrCoder, mesh::vtxidx_t, mesh::faceidx_t>(meshhandle, wr, ac);
+	P proga;
 	ac.encode(proga);
 	coder.flush();
+
+	if (vtxorder == NULL) return;
+	vtxorder->resize(ac.order.size());
+	for (std::size_t i = 0; i < ac.order.size(); ++i) {
+		(*vtxorder)[i] = mesh.conn.org<TRI>(ac.order[i]);
+	}
+}
+template <typename P, typename Models>
+void encode(std::vector<uint8_t> &buf, mesh::Mesh &mesh, Models &models, const ModelConfig &cfg, std::vector<mesh::vtxidx_t> *vtxorder = NULL)
+{
+	if (mesh.faces.only_triangles()) encode<P, true>(buf, mesh, models, cfg, vtxorder);
+	else encode<P, false>(buf, mesh, models, cfg, vtxorder);
 }
 
-void write(std::ostream &os, mesh::Mesh &mesh)
+// first pass of the static models, which restores the connectivity afterwards
+template <typename P, typename Models>
+void learn(mesh::Mesh &mesh, Models &models, const ModelConfig &cfg)
 {
-	compress(os, mesh);
+	std::vector<mesh::conn::Conn::edgeorg> edges(mesh.conn.edges); // the encoder splits the edges
+	std::vector<uint8_t> code;
+	encode<P>(code, mesh, models, cfg);
+	mesh.conn.edges.swap(edges);
+}
+
+template <typename P, arith::Backend B, int POW2>
+void compress(std::vector<uint8_t> &buf, mesh::Mesh &mesh, const ModelConfig &cfg, std::vector<mesh::vtxidx_t> *vtxorder)
+{
+	HryModels<B, POW2> models(mesh, cfg);
+	encode<P>(buf, mesh, models, cfg, vtxorder);
+}
+
+// Two passes: the first one counts the symbols of all models and drops the code. The tables are stored in front of the code
+// of the second pass, which starts with fresh models, since the binary models are still adaptive.
+template <typename P, arith::Backend B>
+void compress_static(std::vector<uint8_t> &buf, mesh::Mesh &mesh, const ModelConfig &cfg, std::vector<mesh::vtxidx_t> *vtxorder)
+{
+	typedef HryModels<B, 0, true> Models;
+	{
+		Models learned(mesh, cfg);
+		learn<P>(mesh, learned, cfg);
+
+		arith::memostream os(buf);
+		learned.tables([&os] (auto &s) { s.build(); s.write(os); });
+	}
+	Models models(mesh, cfg);
+	arith::memistream is(buf.data(), buf.data() + buf.size());
+	models.tables([&is] (auto &s) { s.read(is); });
+	encode<P>(buf, mesh, models, cfg, vtxorder);
+}
+
+// the model groups with power-of-two totals are template arguments of the models
+template <typename P, arith::Backend B>
+void compress(std::vector<uint8_t> &buf, mesh::Mesh &mesh, const ModelConfig &cfg, std::vector<mesh::vtxidx_t> *vtxorder)
+{
+	if (cfg.static_tables) {
+		compress_static<P, B>(buf, mesh, cfg, vtxorder);
+		return;
+	}
+	switch (cfg.pow2) {
+	case 0:
+		compress<P, B, 0>(buf, mesh, cfg, vtxorder);
+		break;
+	case CONN_MODELS:
+		compress<P, B, CONN_MODELS>(buf, mesh, cfg, vtxorder);
+		break;
+	case ATTR_MODELS:
+		compress<P, B, ATTR_MODELS>(buf, mesh, cfg, vtxorder);
+		break;
+	case CONN_MODELS | ATTR_MODELS:
+		compress<P, B, CONN_MODELS | ATTR_MODELS>(buf, mesh, cfg, vtxorder);
+		break;
+	}
+}
+
+template <typename P>
+void compress(std::vector<uint8_t> &buf, mesh::Mesh &mesh, const Options &opts, std::vector<mesh::vtxidx_t> *vtxorder = NULL)
+{
+	switch (opts.backend) {
+	case arith::ARITH:
+		compress<P, arith::ARITH>(buf, mesh, opts.models, vtxorder);
+		break;
+	case arith::RANGE:
+		compress<P, arith::RANGE>(buf, mesh, opts.models, vtxorder);
+		break;
+	case arith::RANS:
+		compress<P, arith::RANS>(buf, mesh, opts.models, vtxorder);
+		break;
+	}
+}
+
+static const uint32_t UNSET = std::numeric_limits<uint32_t>::max();
+
+// The sizes of the mesh in the header, from which the decoder allocates the lists. With deduplicated values the decoder only
+// receives the distinct values of the entries, which are bound to the faces, their corners and their vertices.
+chunks::Sizes coded_sizes(mesh::Mesh &mesh, const ModelConfig &cfg)
+{
+	chunks::Sizes sizes(mesh);
+	if (!cfg.dedup) return sizes;
+	mesh::attr::Attrs &a = mesh.attrs;
+	std::vector<std::vector<mesh::attridx_t>> rep(a.size());
+	std::vector<std::vector<bool>> used(a.size());
+	for (mesh::listidx_t l = 0; l < a.size(); ++l) {
+		attrcode::duplicates(a[l], rep[l]);
+		used[l].assign(a[l].size(), false);
+	}
+	std::vector<bool> seen(mesh.num_vtx(), false);
+	for (mesh::faceidx_t f = 0; f < mesh.num_face(); ++f) {
+		mesh::regidx_t r = a.face2reg(f);
+		for (mesh::listidx_t i = 0; i < a.num_bindings_face_reg(r); ++i) {
+			mesh::listidx_t l = a.binding_reg_facelist(r, i);
+			used[l][rep[l][a.binding_face_attr(f, i)]] = true;
+		}
+		for (mesh::ledgeidx_t e = 0; e < mesh.conn.num_edges(f); ++e) {
+			for (mesh::listidx_t i = 0; i < a.num_bindings_corner_reg(r); ++i) {
+				mesh::listidx_t l = a.binding_reg_cornerlist(r, i);
+				used[l][rep[l][a.binding_corner_attr(f, e, i)]] = true;
+			}
+			mesh::vtxidx_t v = mesh.conn.org(f, e);
+			if (seen[v]) continue;
+			seen[v] = true;
+			mesh::regidx_t vr = a.vtx2reg(v);
+			for (mesh::listidx_t i = 0; i < a.num_bindings_vtx_reg(vr); ++i) {
+				mesh::listidx_t l = a.binding_reg_vtxlist(vr, i);
+				used[l][rep[l][a.binding_vtx_attr(v, i)]] = true;
+			}
+		}
+	}
+	for (mesh::listidx_t l = 0; l < a.size(); ++l) {
+		sizes.attrs[l] = std::count(used[l].begin(), used[l].end(), true);
+	}
+	return sizes;
+}
+
+// copies entries of the lists of src into the mesh of a builder, every entry once
+struct AttrCopy {
+	mesh::Mesh &src;
+	mesh::Builder &builder;
+	std::vector<std::unordered_map<mesh::attridx_t, mesh::attridx_t>> map;
+
+	AttrCopy(mesh::Mesh &_src, mesh::Builder &_builder) : src(_src), builder(_builder), map(_src.attrs.size())
+	{}
+
+	mesh::attridx_t operator()(mesh::listidx_t l, mesh::attridx_t idx)
+	{
+		auto a = map[l].emplace(idx, map[l].size());
+		if (a.second) {
+			builder.alloc_attr(l);
+			std::memcpy(builder.mesh.attrs[l][a.first->second].data(), src.attrs[l][idx].data(), src.attrs[l].fmt().bytes());
+		}
+		return a.first->second;
+	}
+
+	// allocates the vertices of the builder with the regions and attributes of the vertices vtx of src
+	void vertices(const std::vector<mesh::vtxidx_t> &vtx)
+	{
+		builder.alloc_vtx(vtx.size());
+		for (mesh::vtxidx_t v = 0; v < vtx.size(); ++v) {
+			mesh::regidx_t r = src.attrs.vtx2reg(vtx[v]);
+			builder.vtx_reg(v, r);
+			for (mesh::listidx_t a = 0; a < src.attrs.num_bindings_vtx_reg(r); ++a) {
+				builder.bind_vtx_attr(v, a, (*this)(src.attrs.binding_reg_vtxlist(r, a), src.attrs.binding_vtx_attr(vtx[v], a)));
+			}
+		}
+	}
+};
+
+// Copies the given faces (of chunk c) with their vertices and attributes into a mesh of its own; local holds the index of
+// every face within its chunk and isolated the vertices without faces which the chunk takes along. vtx receives the
+// original indices of the vertices of the chunk.
+void extract(mesh::Mesh &mesh, const std::vector<uint32_t> &part, const std::vector<mesh::faceidx_t> &local, const std::vector<mesh::faceidx_t> &faces, uint32_t c, const std::vector<mesh::vtxidx_t> &isolated, mesh::Mesh &dst, std::vector<mesh::vtxidx_t> &vtx)
+{
+	mesh::Builder builder(dst);
+	chunks::copy_layout(builder, mesh);
+
+	std::unordered_map<mesh::vtxidx_t, mesh::vtxidx_t> vmap(faces.size());
+	dst.conn.reserve(faces.size());
+	for (mesh::faceidx_t i = 0; i < faces.size(); ++i) {
+		mesh::faceidx_t f = faces[i];
+		dst.conn.add_face(mesh.conn.num_edges(f));
+		for (mesh::ledgeidx_t e = 0; e < mesh.conn.num_edges(f); ++e) {
+			auto v = vmap.emplace(mesh.conn.org(f, e), vtx.size());
+			if (v.second) vtx.push_back(mesh.conn.org(f, e));
+			dst.conn.set_org(i, e, v.first->second);
+		}
+	}
+	// twins in other chunks become borders
+	for (mesh::faceidx_t i = 0; i < faces.size(); ++i) {
+		for (mesh::ledgeidx_t e = 0; e < dst.conn.num_edges(i); ++e) {
+			mesh::conn::fepair t = mesh.conn.twin(mesh::conn::fepair(faces[i], e));
+			if (part[t.f()] == c) dst.conn.edges[dst.conn.edge(mesh::conn::fepair(i, e))].twin = dst.conn.edge(mesh::conn::fepair(local[t.f()], t.e()));
+		}
+	}
+	vtx.insert(vtx.end(), isolated.begin(), isolated.end());
+	AttrCopy attr(mesh, builder);
+	attr.vertices(vtx);
+	builder.alloc_face(faces.size(), dst.faces.size_edge());
+	for (mesh::faceidx_t i = 0; i < faces.size(); ++i) {
+		mesh::faceidx_t f = faces[i];
+		mesh::regidx_t r = mesh.attrs.face2reg(f);
+		builder.face_reg(i, r);
+		for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_face_reg(r); ++a) {
+			builder.bind_face_attr(i, a, attr(mesh.attrs.binding_reg_facelist(r, a), mesh.attrs.binding_face_attr(f, a)));
+		}
+		for (mesh::ledgeidx_t e = 0; e < mesh.conn.num_edges(f); ++e) {
+			for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_corner_reg(r); ++a) {
+				builder.bind_corner_attr(i, e, a, attr(mesh.attrs.binding_reg_cornerlist(r, a), mesh.attrs.binding_corner_attr(f, e, a)));
+			}
+		}
+	}
+}
+
+struct Chunk {
+	std::vector<uint8_t> code;
+	uint32_t bytes;
+	chunks::Sizes sizes;
+	std::vector<mesh::vtxidx_t> vtx; // original indices of the vertices in decoding order
+	std::vector<std::pair<mesh::vtxidx_t, mesh::vtxidx_t>> shared;
+
+	// codes the mesh of the chunk, orig holds the original indices of its vertices
+	void code_mesh(mesh::Mesh &sub, const std::vector<mesh::vtxidx_t> &orig, const Options &opts)
+	{
+		std::vector<mesh::vtxidx_t> order;
+		sizes = coded_sizes(sub, opts.models);
+		compress<progress::voidhandle>(code, sub, opts, &order);
+		bytes = code.size();
+		vtx.resize(order.size());
+		std::vector<bool> reached(orig.size(), false);
+		for (mesh::vtxidx_t v = 0; v < order.size(); ++v) {
+			vtx[v] = orig[order[v]];
+			reached[order[v]] = true;
+		}
+		// vertices without faces are not traversed, the decoder allocates them after the others
+		for (mesh::vtxidx_t v = 0; v < orig.size(); ++v) {
+			if (!reached[v]) vtx.push_back(orig[v]);
+		}
+	}
+
+	// Numbers the vertices of the chunk in the merged mesh (idx holds the number of every original vertex or UNSET) and
+	// collects the shared ones. The sizes of the chunk are added to the total ones.
+	void number(std::vector<mesh::vtxidx_t> &idx, chunks::Sizes &total)
+	{
+		for (mesh::vtxidx_t v = 0; v < vtx.size(); ++v) {
+			mesh::vtxidx_t o = vtx[v];
+			if (idx[o] == UNSET) idx[o] = total.nvfe[0]++;
+			else shared.push_back(std::make_pair(v, idx[o]));
+		}
+		total.nvfe[1] += sizes.nvfe[1];
+		total.nvfe[2] += sizes.nvfe[2];
+		for (mesh::listidx_t l = 0; l < total.attrs.size(); ++l) {
+			total.attrs[l] += sizes.attrs[l];
+		}
+	}
+};
+
+// see chunks.h
+void write_chunked(std::ostream &os, mesh::Mesh &mesh, const Options &opts)
+{
+	std::vector<uint32_t> part;
+	uint32_t n = partition::partition(mesh, opts.chunks, part, opts.threads);
+	std::vector<std::vector<mesh::faceidx_t>> faces(n);
+	std::vector<mesh::faceidx_t> local(mesh.num_face());
+	for (mesh::faceidx_t f = 0; f < mesh.num_face(); ++f) {
+		local[f] = faces[part[f]].size();
+		faces[part[f]].push_back(f);
+	}
+	// the vertices without faces go to the last chunk, the coder needs faces
+	std::vector<bool> used(mesh.num_vtx(), false);
+	for (mesh::faceidx_t f = 0; f < mesh.num_face(); ++f) {
+		for (mesh::ledgeidx_t e = 0; e < mesh.conn.num_edges(f); ++e) used[mesh.conn.org(f, e)] = true;
+	}
+	std::vector<mesh::vtxidx_t> isolated, none;
+	for (mesh::vtxidx_t v = 0; v < mesh.num_vtx(); ++v) {
+		if (!used[v]) isolated.push_back(v);
+	}
+
+	std::vector<Chunk> coded(n);
+	parallel::for_each(n, opts.threads, [&] (std::size_t c) {
+		mesh::Mesh sub;
+		std::vector<mesh::vtxidx_t> vtx;
+		extract(mesh, part, local, faces[c], c, c + 1 == n ? isolated : none, sub, vtx);
+		coded[c].code_mesh(sub, vtx, opts);
+	});
+
+	// number the vertices of the merged mesh
+	std::vector<mesh::vtxidx_t> idx(mesh.num_vtx(), UNSET);
+	chunks::Sizes total;
+	total.attrs.resize(mesh.attrs.size(), 0);
+	for (uint32_t c = 0; c < n; ++c) {
+		coded[c].number(idx, total);
+	}
+
+	HeaderWriter hw(os);
+	hw.write_syntax(mesh, opts, total, n);
+	for (uint32_t c = 0; c < n; ++c) {
+		hw.write_chunk(coded[c].sizes, coded[c].shared, coded[c].bytes);
+	}
+	for (uint32_t c = 0; c < n; ++c) {
+		os.write((const char*)coded[c].code.data(), coded[c].code.size());
+	}
+	os.flush();
+}
+
+static const std::size_t FACE_BYTES = 192; // memory of a triangle in a window while it is coded, measured
+
+// faces of a window: their numbers of vertices, their vertices and their entries of the face lists
+struct Window {
+	std::vector<mesh::ledgeidx_t> ne;
+	std::vector<mesh::vtxidx_t> org;
+	std::vector<unsigned char> attrs;
+	std::vector<mesh::vtxidx_t> isolated; // vertices without faces, the last window takes them along
+
+	// builds the mesh of the window with the vertices it uses and their attributes; vtx receives their indices in mesh
+	void build(mesh::Mesh &mesh, mesh::Mesh &dst, std::vector<mesh::vtxidx_t> &vtx) const
+	{
+		mesh::Builder builder(dst);
+		chunks::copy_layout(builder, mesh);
+
+		std::unordered_map<mesh::vtxidx_t, mesh::vtxidx_t> vmap(ne.size());
+		std::vector<mesh::vtxidx_t> local(org.size());
+		for (std::size_t i = 0; i < org.size(); ++i) {
+			auto v = vmap.emplace(org[i], vtx.size());
+			if (v.second) vtx.push_back(org[i]);
+			local[i] = v.first->second;
+		}
+		vtx.insert(vtx.end(), isolated.begin(), isolated.end());
+		AttrCopy attr(mesh, builder);
+		attr.vertices(vtx);
+
+		builder.alloc_face(ne.size());
+		builder.bulk(ne.size());
+		const unsigned char *a = attrs.data();
+		const mesh::vtxidx_t *o = local.data();
+		for (mesh::faceidx_t f = 0; f < ne.size(); ++f) {
+			builder.face_reg(f, 0);
+			for (mesh::listidx_t b = 0; b < mesh.attrs.num_bindings_face_reg(0); ++b) {
+				mesh::listidx_t l = mesh.attrs.binding_reg_facelist(0, b);
+				mesh::attridx_t idx = builder.alloc_attr(l);
+				std::memcpy(dst.attrs[l][idx].data(), a, dst.attrs[l].fmt().bytes());
+				a += dst.attrs[l].fmt().bytes();
+				builder.bind_face_attr(f, b, idx);
+			}
+			builder.face_begin(ne[f]);
+			for (mesh::ledgeidx_t e = 0; e < ne[f]; ++e) {
+				builder.set_org(*o++);
+			}
+			builder.face_end();
+		}
+		builder.finish(1); // the windows are built concurrently
+	}
+};
+
+// State of write_stream(): the faces are collected into one window per thread. When all of them are full, they are coded
+// concurrently and their code is appended to a temporary file, only the directory entries of the chunks are kept.
+struct Stream {
+	mesh::Mesh &mesh;
+	const Options &opts;
+	std::size_t window, face_bytes; // faces per window and bytes of the face attributes of a face
+	std::vector<Window> windows;
+	std::size_t cur; // window which is filled
+	std::vector<mesh::vtxidx_t> idx; // number of every vertex in the merged mesh
+	chunks::Sizes total;
+	std::vector<Chunk> dir; // chunks without their code
+	std::FILE *tmp;
+
+	Stream(mesh::Mesh &_mesh, const Options &_opts) : mesh(_mesh), opts(_opts), face_bytes(0), cur(0), idx(_mesh.num_vtx(), UNSET), tmp(NULL)
+	{
+		if (mesh.num_face() != 0 || mesh.attrs.num_regs_face() != 1 || mesh.attrs.num_bindings_corner != 0) throw std::runtime_error("Streaming needs a mesh without faces and with a single face region");
+		for (mesh::listidx_t b = 0; b < mesh.attrs.num_bindings_face_reg(0); ++b) {
+			face_bytes += mesh.attrs[mesh.attrs.binding_reg_facelist(0, b)].fmt().bytes();
+		}
+		total.attrs.resize(mesh.attrs.size(), 0);
+
+		// the vertices and their numbers stay in memory
+		std::size_t resident = idx.size() * sizeof(mesh::vtxidx_t) + mesh.attrs.vtx_regs.size() * sizeof(mesh::regidx_t) + mesh.attrs.bindings_vtx_attr.size() * sizeof(mesh::attridx_t);
+		for (mesh::listidx_t l = 0; l < mesh.attrs.size(); ++l) {
+			resident += mesh.attrs[l].bytes();
+		}
+		unsigned int threads = parallel::num_threads(opts.threads);
+		window = opts.memory > resident ? (opts.memory - resident) / (threads * (FACE_BYTES + face_bytes)) : 0;
+		if (window == 0) throw std::runtime_error("The memory cap is too small for the vertices (" + std::to_string(resident >> 20) + " MiB)");
+		windows.resize(threads);
+
+		tmp = std::tmpfile();
+		if (tmp == NULL) throw std::runtime_error("Cannot create a temporary file");
+	}
+	~Stream()
+	{
+		if (tmp != NULL) std::fclose(tmp);
+	}
+
+	void face(mesh::ledgeidx_t ne, const mesh::vtxidx_t *org, const unsigned char *attrs)
+	{
+		for (mesh::ledgeidx_t e = 0; e < ne; ++e) {
+			if (org[e] >= idx.size()) throw std::runtime_error("Invalid vertex index");
+		}
+		if (ne >= mesh.faces.have_edges.size() || !mesh.faces.have_edges[ne]) throw std::runtime_error("Face size is missing in the layout");
+		// the windows are flushed on the next face, so the last one is left for finish()
+		if (windows[cur].ne.size() == window && ++cur == windows.size()) flush();
+		Window &w = windows[cur];
+		w.ne.push_back(ne);
+		w.org.insert(w.org.end(), org, org + ne);
+		w.attrs.insert(w.attrs.end(), attrs, attrs + face_bytes);
+	}
+
+	void flush()
+	{
+		std::size_t n = cur + (cur < windows.size() && !windows[cur].ne.empty());
+		std::vector<Chunk> coded(n);
+		parallel::for_each(n, opts.threads, [&] (std::size_t c) {
+			mesh::Mesh sub;
+			std::vector<mesh::vtxidx_t> vtx;
+			windows[c].build(mesh, sub, vtx);
+			coded[c].code_mesh(sub, vtx, opts);
+		});
+		for (std::size_t c = 0; c < n; ++c) {
+			coded[c].number(idx, total);
+			if (std::fwrite(coded[c].code.data(), 1, coded[c].code.size(), tmp) != coded[c].code.size()) throw std::runtime_error("Cannot write the temporary file");
+			std::vector<uint8_t>().swap(coded[c].code);
+			std::vector<mesh::vtxidx_t>().swap(coded[c].vtx);
+			dir.push_back(std::move(coded[c]));
+			windows[c] = Window();
+		}
+		cur = 0;
+	}
+
+	void finish(std::ostream &os)
+	{
+		// the vertices which no chunk has numbered and no window uses are coded with the last window
+		std::vector<bool> used(idx.size(), false);
+		for (std::size_t c = 0; c <= cur; ++c) {
+			for (std::size_t i = 0; i < windows[c].org.size(); ++i) used[windows[c].org[i]] = true;
+		}
+		for (mesh::vtxidx_t v = 0; v < idx.size(); ++v) {
+			if (idx[v] == UNSET && !used[v]) windows[cur].isolated.push_back(v);
+		}
+		flush();
+		HeaderWriter hw(os);
+		hw.write_syntax(mesh, opts, total, dir.size());
+		for (std::size_t c = 0; c < dir.size(); ++c) {
+			hw.write_chunk(dir[c].sizes, dir[c].shared, dir[c].bytes);
+		}
+		std::rewind(tmp);
+		std::vector<char> buf(1 << 20);
+		for (std::size_t len; (len = std::fread(buf.data(), 1, buf.size(), tmp)) != 0;) {
+			os.write(buf.data(), len);
+		}
+		os.flush();
+	}
+};
+
+void check(const Options &opts)
+{
+	if (opts.models.static_tables && opts.models.pow2) throw std::runtime_error("Static models cannot be combined with power-of-two totals");
+	if (opts.models.static_tables && opts.models.prior) throw std::runtime_error("Static models cannot be combined with a prior");
+	if (opts.models.prior) find_prior(opts.models.prior);
+	if (opts.models.list_streams && opts.models.inline_attrs) throw std::runtime_error("Streams of the lists cannot be combined with inline attributes");
+}
+
+void write_stream(std::ostream &os, mesh::Mesh &mesh, const std::function<void(const FaceHandler&)> &faces, const Options &opts)
+{
+	check(opts);
+	Stream stream(mesh, opts);
+	faces([&stream] (mesh::ledgeidx_t ne, const mesh::vtxidx_t *org, const unsigned char *attrs) { stream.face(ne, org, attrs); });
+	if (stream.dir.empty() && stream.windows[0].ne.empty()) {
+		write(os, mesh, opts);
+		return;
+	}
+	stream.finish(os);
+}
+
+void write(std::ostream &os, mesh::Mesh &mesh, const Options &opts)
+{
+	check(opts);
+	if (opts.chunks > 1 && mesh.num_face() > 1) {
+		write_chunked(os, mesh, opts);
+		return;
+	}
+	HeaderWriter hw(os);
+	hw.write_syntax(mesh, opts, coded_sizes(mesh, opts.models), 0);
+
+	// the coders write to memory, the stream is touched once at the end; the threads of the chunks code the lists
+	std::vector<uint8_t> buf;
+	Options lopts(opts);
+	lopts.models.threads = opts.threads;
+	compress<progress::handle>(buf, mesh, lopts);
+	os.write((const char*)buf.data(), buf.size());
+	os.flush();
+}
+
+void count_prior(mesh::Mesh &mesh, std::vector<std::vector<uint64_t>> &counts)
+{
+	counts.resize(PRIOR_NUM, std::vector<uint64_t>(PRIOR_SYMS, 0));
+	HryModels<arith::ARITH, 0, true> models(mesh);
+	learn<progress::handle>(mesh, models, ModelConfig());
+
+	for (int o = 0; o < models.MAXORDER; ++o) {
+		for (uint32_t i = 0; i < models.conn_op.stat[o].n; ++i) {
+			counts[PRIOR_OP + o][i] += models.conn_op.stat[o].C[i];
+		}
+	}
+	models.prior_stats([&counts] (int t, auto &s) {
+		for (uint32_t i = 0; i < s.n; ++i) {
+			counts[t][i] += s.C[i];
+		}
+	});
 }
 
 }
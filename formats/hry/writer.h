@@ -9,14 +9,40 @@
 
 #pragma once
 
+#include <functional>
 #include <ostream>
+#include <vector>
 
 #include "structs/mesh.h"
+#include "arith/coder.h"
+#include "common.h"
 
 namespace hry {
 namespace writer {
 
-void write(std::ostream &os, mesh::Mesh &mesh);
+struct Options {
+	arith::Backend backend;
+	ModelConfig models;
+	uint32_t chunks; // number of independently coded chunks, 0 or 1 for a single stream
+	unsigned int threads; // threads for coding the chunks, 0 for all cores
+	std::size_t memory; // memory cap of write_stream() in bytes
+
+	Options() : backend(arith::ARITH), chunks(0), threads(0), memory(0)
+	{}
+};
+
+void write(std::ostream &os, mesh::Mesh &mesh, const Options &opts = Options());
+
+// a face with its number of vertices, its vertices and its entries of the face lists
+typedef std::function<void(mesh::ledgeidx_t, const mesh::vtxidx_t*, const unsigned char*)> FaceHandler;
+
+// Streaming compression into a chunked file within the memory cap of the options: mesh holds the layout and the vertices
+// with the bounds of all lists and the face sizes, but no faces. These are passed by faces(f) to f one by one, in file order
+// and in face region 0. They are coded in windows of consecutive faces, which are as large as the memory cap allows.
+void write_stream(std::ostream &os, mesh::Mesh &mesh, const std::function<void(const FaceHandler&)> &faces, const Options &opts = Options());
+
+// Adds the symbol counts of the mesh to the tables of a prior (PRIOR_NUM tables of PRIOR_SYMS counts), see prior.h
+void count_prior(mesh::Mesh &mesh, std::vector<std::vector<uint64_t>> &counts);
 
 }
 }
@@ -320,8 +320,95 @@ struct BinLEReader {
 	}
 };
 
-template <typename R>
-void readloop(std::istream &is, const Header &header, const std::vector<int> *perms, mesh::Builder &builder, R &&read)
+// Receives the elements of readloop: elem() returns the memory of an attribute, or NULL to drop it, the vertices of a face
+// are passed between face_begin() and face_end() and end() is called after each element of a list.
+struct BuilderSink {
+	mesh::Builder &builder;
+
+	BuilderSink(mesh::Builder &_builder) : builder(_builder)
+	{}
+
+	unsigned char *elem(int list, int j, int off)
+	{
+		return builder.elem(list, j, off);
+	}
+	void face_begin(mesh::ledgeidx_t ne)
+	{
+		builder.face_begin(ne);
+	}
+	void set_org(mesh::vtxidx_t v)
+	{
+		builder.set_org(v);
+	}
+	void face_end()
+	{
+		builder.face_end();
+	}
+	void end(int, int)
+	{}
+};
+
+// first pass of streaming: stores the vertices, the faces only contribute their sizes and the bounds of their attributes
+struct LayoutSink : BuilderSink {
+	mixing::Array face;
+
+	LayoutSink(mesh::Builder &builder) : BuilderSink(builder), face(builder.mesh.attrs[0].fmt())
+	{
+		face.resize(1);
+		quant::reset_bounds(builder.mesh.attrs[0]);
+	}
+
+	unsigned char *elem(int list, int j, int off)
+	{
+		return list == 0 ? face[0].data(off) : builder.elem(list, j, off);
+	}
+	void face_begin(mesh::ledgeidx_t ne)
+	{
+		builder.seen_edge(ne);
+	}
+	void set_org(mesh::vtxidx_t)
+	{}
+	void face_end()
+	{}
+	void end(int list, int)
+	{
+		if (list == 0) quant::extend_bounds(builder.mesh.attrs[0], face[0]);
+	}
+};
+
+// second pass of streaming: hands out the faces and drops the vertices
+struct FaceSink {
+	const FaceHandler &handler;
+	mixing::Array face;
+	std::vector<mesh::vtxidx_t> org;
+
+	FaceSink(const mixing::Fmt &fmt, const FaceHandler &_handler) : handler(_handler), face(fmt)
+	{
+		face.resize(1);
+	}
+
+	unsigned char *elem(int list, int, int off)
+	{
+		return list == 0 ? face[0].data(off) : NULL;
+	}
+	void face_begin(mesh::ledgeidx_t)
+	{
+		org.clear();
+	}
+	void set_org(mesh::vtxidx_t v)
+	{
+		org.push_back(v);
+	}
+	void face_end()
+	{}
+	void end(int list, int)
+	{
+		if (list == 0) handler(org.size(), org.data(), face.data());
+	}
+};
+
+template <typename S, typename R>
+void readloop(std::istream &is, const Header &header, const std::vector<int> *perms, S &sink, R &&read)
 {
 	progress::handle prog;
 	int face_idx = header["face"];
@@ -346,21 +433,22 @@ void readloop(std::istream &is, const Header &header, const std::vector<int> *pe
 					if (perm[k] == -1) { // not an attribute
 						uint64_t listlen = read(is, ign, prop.list_len_type);
 						if (prop.list_len_type != mixing::NONE && i == face_idx && k == vi_idx) { // ...but connectivity
-							builder.face_begin(listlen);
+							sink.face_begin(listlen);
 							for (int l = 0; l < listlen; ++l) {
-								builder.set_org(read(is, ign, prop.type));
+								sink.set_org(read(is, ign, prop.type));
 							}
-							builder.face_end();
+							sink.face_end();
 						} else { // no connectivity and not an attribute: ignore
 							for (int l = 0; l < listlen; ++l) {
 								read(is, ign, prop.type);
 							}
 						}
 					} else { // attribute
-						unsigned char *dst = builder.elem(list, j, perm[k]);
-						if (dst != NULL) read(is, dst, prop.type);
+						unsigned char *dst = sink.elem(list, j, perm[k]);
+						read(is, dst != NULL ? dst : ign, prop.type);
 					}
 				}
+				sink.end(list, j);
 				prog(cur++);
 			}
 		} else {
@@ -379,54 +467,103 @@ void readloop(std::istream &is, const Header &header, const std::vector<int> *pe
 	prog.end();
 }
 
-void read(std::istream &is, mesh::Mesh &mesh)
+template <typename S>
+void readloop(std::istream &is, const Header &header, const std::vector<int> *perms, S &sink)
 {
-	mesh::Builder builder(mesh);
-	Header header = read_header(is);
+	switch (header.fmt)
+	{
+	case ASCII:
+		readloop(is, header, perms, sink, ASCIIReader());
+		break;
+	case BIN_BE:
+		readloop(is, header, perms, sink, BinBEReader());
+		break;
+	case BIN_LE:
+		readloop(is, header, perms, sink, BinLEReader());
+		break;
+	}
+}
 
-	// add attributes and allocate memory
+void init_perms(const Header &header, std::vector<int> *perms, mixing::Fmt *fmts, mixing::Interps *interps)
+{
 	int idxs[] = { header["face"], header["vertex"] };
+	if (idxs[0] == -1 || idxs[1] == -1) throw std::runtime_error("Missing face or vertex element");
+	for (int i = 0; i < 2; ++i) {
+		header[idxs[i]].init(perms[i], fmts[i], interps[i]);
+	}
+}
 
-	std::vector<int> perms[2];
+// adds the lists and regions and allocates the vertices and, if alloc_faces is set, the faces
+void init(const Header &header, std::vector<int> *perms, mesh::Builder &builder, bool alloc_faces)
+{
+	mixing::Fmt fmts[2];
+	mixing::Interps interps[2];
+	init_perms(header, perms, fmts, interps);
+
+	int nf = header[header["face"]].len, nv = header[header["vertex"]].len;
 	for (int i = 0; i < 2; ++i) {
-		mixing::Fmt fmt;
-		mixing::Interps interps;
-		header[idxs[i]].init(perms[i], fmt, interps);
-		builder.add_list(fmt, interps, i == 0 ? mesh::attr::FACE : mesh::attr::VTX);
-		builder.alloc_attr(i, header[idxs[i]].len);
+		builder.add_list(fmts[i], interps[i], i == 0 ? mesh::attr::FACE : mesh::attr::VTX);
 	}
+	if (alloc_faces) builder.alloc_attr(0, nf);
+	builder.alloc_attr(1, nv);
 	builder.init_bindings(1, 1, 0);
 	builder.bind_reg_facelist(builder.add_face_region(1, 0), 0, 0);
 	builder.bind_reg_vtxlist(builder.add_vtx_region(1), 0, 1);
 
-	int nf = header[idxs[0]].len, nv = header[idxs[1]].len;
-	builder.alloc_face(nf);
-	builder.alloc_vtx(nv);
-	for (int i = 0; i < nf; ++i) {
-		builder.bind_face_attr(i, 0, i);
-		builder.face_reg(i, 0);
+	if (alloc_faces) {
+		builder.bulk(nf);
+		builder.alloc_face(nf);
+		for (int i = 0; i < nf; ++i) {
+			builder.bind_face_attr(i, 0, i);
+			builder.face_reg(i, 0);
+		}
 	}
+	builder.alloc_vtx(nv);
 	for (int i = 0; i < nv; ++i) {
 		builder.bind_vtx_attr(i, 0, i);
 		builder.vtx_reg(i, 0);
 	}
+}
+
+void read(std::istream &is, mesh::Mesh &mesh)
+{
+	mesh::Builder builder(mesh);
+	Header header = read_header(is);
+	std::vector<int> perms[2];
+	init(header, perms, builder, true);
 
 	// load mesh
-	switch (header.fmt)
-	{
-	case ASCII:
-		readloop(is, header, perms, builder, ASCIIReader());
-		break;
-	case BIN_BE:
-		readloop(is, header, perms, builder, BinBEReader());
-		break;
-	case BIN_LE:
-		readloop(is, header, perms, builder, BinLEReader());
-		break;
-	}
+	BuilderSink sink(builder);
+	readloop(is, header, perms, sink);
+	builder.finish();
 
 	quant::set_bounds(mesh.attrs);
 }
 
+void read_layout(std::istream &is, mesh::Mesh &mesh)
+{
+	mesh::Builder builder(mesh);
+	Header header = read_header(is);
+	std::vector<int> perms[2];
+	init(header, perms, builder, false);
+
+	LayoutSink sink(builder);
+	readloop(is, header, perms, sink);
+
+	quant::set_bounds(mesh.attrs[1]);
+}
+
+void read_faces(std::istream &is, const FaceHandler &handler)
+{
+	Header header = read_header(is);
+	std::vector<int> perms[2];
+	mixing::Fmt fmts[2];
+	mixing::Interps interps[2];
+	init_perms(header, perms, fmts, interps);
+
+	FaceSink sink(fmts[0], handler);
+	readloop(is, header, perms, sink);
+}
+
 }
 }
@@ -10,6 +10,8 @@
 #pragma once
 
 #include <istream>
+#include <functional>
+
 #include "structs/mesh.h"
 
 namespace ply {
@@ -17,5 +19,13 @@ namespace reader {
 
 void read(std::istream &is, mesh::Mesh &mesh);
 
+// a face with its number of vertices, its vertices and its entry of the face attribute list
+typedef std::function<void(mesh::ledgeidx_t, const mesh::vtxidx_t*, const unsigned char*)> FaceHandler;
+
+// Streaming in two passes over the file: read_layout() reads the lists and the vertices like read(), but no faces; only the
+// face sizes and the bounds of the face attributes are collected. read_faces() then hands out the faces in file order.
+void read_layout(std::istream &is, mesh::Mesh &mesh);
+void read_faces(std::istream &is, const FaceHandler &handler);
+
 }
 }
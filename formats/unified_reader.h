@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <istream>
 #include <fstream>
+#include <functional>
 
 #include "utils/endian.h"
 
@@ -85,5 +86,41 @@ std::size_t read(const std::string &fn, mesh::Mesh &mesh)
 	return size;
 }
 
+// Streaming in two passes over the file, which is only supported for PLY files: read_layout() reads the mesh without its
+// faces, read_faces() hands them out one by one (see ply/reader.h).
+typedef std::function<void(mesh::ledgeidx_t, const mesh::vtxidx_t*, const unsigned char*)> FaceHandler;
+std::size_t read_layout(const std::string &fn, mesh::Mesh &mesh)
+{
+	std::ifstream is(fn, std::ifstream::binary);
+	is.seekg(0, std::ios::end);
+	std::size_t size = is.tellg();
+	is.seekg(0, std::ios::beg);
+	switch (get_mesh_type(is, fn))
+	{
+#ifdef WITH_PLY
+	case PLY:
+		ply::reader::read_layout(is, mesh);
+		break;
+#endif
+	default:
+		throw std::runtime_error("Only PLY files can be streamed");
+	}
+	return size;
+}
+void read_faces(const std::string &fn, const FaceHandler &f)
+{
+	std::ifstream is(fn, std::ifstream::binary);
+	switch (get_mesh_type(is, fn))
+	{
+#ifdef WITH_PLY
+	case PLY:
+		ply::reader::read_faces(is, f);
+		break;
+#endif
+	default:
+		throw std::runtime_error("Only PLY files can be streamed");
+	}
+}
+
 }
 }
@@ -24,13 +24,22 @@ struct Args {
 	struct Quant {
 		int l, o, q;
 	};
+#ifdef WITH_HRY
+	struct Model {
+		int l, o;
+		hry::AttrModel m;
+	};
+#endif
 	std::string in, out;
 	unified::writer::FileType fmt;
 	std::vector<Quant> quant;
+#ifdef WITH_HRY
+	std::vector<Model> models;
+#endif
 	bool clearquant;
-	bool ply_ascii;
+	unified::writer::Options opts;
 
-	Args(int argc, const char **argv) : fmt(unified::writer::UNKNOWN), ply_ascii(false), quant(false), clearquant(false)
+	Args(int argc, const char **argv) : fmt(unified::writer::UNKNOWN), quant(false), clearquant(false)
 	{
 		using namespace std::string_literals;
 		args::parser args(argc, argv, "Harry mesh compressor");
@@ -44,6 +53,19 @@ struct Args {
 #ifdef WITH_PLY
 		const int ARG_PAS = args.add_opt(     "ply-ascii",   "PLY writer: Use ASCII format");
 #endif
+#ifdef WITH_HRY
+		const int ARG_BCK = args.add_opt('b', "backend",     "HRY writer: Entropy coder backend (arith, range, rans)");
+		const int ARG_PW2 = args.add_opt('p', "pow2",        "HRY writer: Power-of-two model totals for a model group (conn, attr)");
+		const int ARG_MDL = args.add_opt('m', "model",       "HRY writer: Model for the selected attributes (byte, bits)");
+		const int ARG_STC = args.add_opt('s', "static",      "HRY writer: Static model tables from a first pass (slower encoding, faster decoding)");
+		const int ARG_PRI = args.add_opt('r', "prior",       "HRY writer: Trained initial model counts for small meshes (generic)");
+		const int ARG_CHK = args.add_opt('k', "chunks",      "HRY writer: Number of independently coded chunks for parallel coding");
+		const int ARG_THR = args.add_opt('j', "threads",     "HRY writer: Threads for coding the chunks or the streams of the lists (default: all cores)");
+		const int ARG_MEM = args.add_opt('M', "memory",      "HRY writer: Stream a PLY input in chunks within a memory cap (MiB)");
+		const int ARG_INL = args.add_opt('i', "inline",      "HRY writer: Code the attributes during the traversal into a stream of their own (single pass)");
+		const int ARG_DUP = args.add_opt('d', "dedup",       "HRY writer: Code attribute values, which repeat an earlier value of their list, as references to it");
+		const int ARG_LSS = args.add_opt('L', "list-streams", "HRY writer: Code every attribute list into a stream of its own, which are coded in parallel");
+#endif
 
 		int cur_l, cur_a = -1;
 		for (int arg = args.next(); arg != args::parser::end; arg = args.next()) {
@@ -65,7 +87,20 @@ struct Args {
 			else if (arg == ARG_QUA) { quant.push_back(Quant{ cur_l, cur_a, args.val<int>() }); cur_a = -1; }
 			else if (arg == ARG_CQU) clearquant = true;
 #ifdef WITH_PLY
-			else if (arg == ARG_PAS) ply_ascii  = true;
+			else if (arg == ARG_PAS) opts.ply_ascii = true;
+#endif
+#ifdef WITH_HRY
+			else if (arg == ARG_BCK) opts.hry.backend = args.map("arith"s, arith::ARITH, "range"s, arith::RANGE, "rans"s, arith::RANS);
+			else if (arg == ARG_PW2) opts.hry.models.pow2 |= args.map("conn"s, hry::CONN_MODELS, "attr"s, hry::ATTR_MODELS);
+			else if (arg == ARG_MDL) { models.push_back(Model{ cur_l, cur_a, args.map("byte"s, hry::BYTE_MODEL, "bits"s, hry::BIT_MODEL) }); cur_a = -1; }
+			else if (arg == ARG_STC) opts.hry.models.static_tables = true;
+			else if (arg == ARG_PRI) opts.hry.models.prior = args.map("generic"s, 1);
+			else if (arg == ARG_CHK) opts.hry.chunks = args.val<uint32_t>();
+			else if (arg == ARG_THR) opts.hry.threads = args.val<unsigned int>();
+			else if (arg == ARG_MEM) opts.hry.memory = args.val<std::size_t>() << 20;
+			else if (arg == ARG_INL) opts.hry.models.inline_attrs = true;
+			else if (arg == ARG_DUP) opts.hry.models.dedup = true;
+			else if (arg == ARG_LSS) opts.hry.models.list_streams = true;
 #endif
 		}
 	}
@@ -90,14 +125,39 @@ void convert_quant(const mesh::attr::Attrs &attrs, const std::vector<Args::Quant
 	}
 }
 
+#ifdef WITH_HRY
+void convert_models(const mesh::attr::Attrs &attrs, const std::vector<Args::Model> &src, std::vector<std::vector<uint8_t>> &dst)
+{
+	dst.resize(attrs.size());
+	for (mesh::listidx_t l = 0; l < attrs.size(); ++l) {
+		dst[l].resize(attrs[l].fmt().size(), hry::BYTE_MODEL);
+	}
+	for (std::size_t i = 0; i < src.size(); ++i) {
+		Args::Model m = src[i];
+		if (m.l < 0 || m.l >= (int)attrs.size()) throw std::runtime_error("Invalid list index");
+		if (m.o == -1) {
+			std::fill(dst[m.l].begin(), dst[m.l].end(), m.m);
+		} else {
+			if (m.o < 0 || m.o >= attrs[m.l].fmt().size()) throw std::runtime_error("Invalid attribute index");
+			dst[m.l][m.o] = m.m;
+		}
+	}
+}
+#endif
+
 int main(int argc, const char **argv)
 {
 	Args args(argc, argv);
 
+	bool stream = false;
+#ifdef WITH_HRY
+	stream = args.opts.hry.memory != 0;
+#endif
+
 	mesh::Mesh mesh;
 	std::cout << "Reading input..." << std::endl;
 	std::chrono::high_resolution_clock::time_point t0 = std::chrono::high_resolution_clock::now();
-	std::size_t inbytes = unified::reader::read(args.in, mesh);
+	std::size_t inbytes = stream ? unified::reader::read_layout(args.in, mesh) : unified::reader::read(args.in, mesh);
 	std::chrono::high_resolution_clock::time_point t1 = std::chrono::high_resolution_clock::now();
 	std::cout << "Reading input took " << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << " ms." << std::endl;
 
@@ -105,13 +165,23 @@ int main(int argc, const char **argv)
 		std::cout << "Quantization..." << std::endl;
 		std::vector<quant::Quant> quant;
 		convert_quant(mesh.attrs, args.quant, quant);
+		for (std::size_t i = 0; i < quant.size(); ++i) {
+			if (stream && mesh.attrs[quant[i].l].target == mesh::attr::FACE) throw std::runtime_error("Face attributes cannot be quantized while streaming");
+		}
 		quant::requant(mesh.attrs, quant, args.clearquant);
 	}
+#ifdef WITH_HRY
+	convert_models(mesh.attrs, args.models, args.opts.hry.models.attr_models);
+#endif
 	std::chrono::high_resolution_clock::time_point t2 = std::chrono::high_resolution_clock::now();
 	if (!args.quant.empty() || args.clearquant) std::cout << "Quantization took " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << " ms." << std::endl;
 
 	std::cout << "Writing output..." << std::endl;
-	std::size_t outbytes = unified::writer::write(args.out, mesh, args.fmt, args.ply_ascii);
+	std::size_t outbytes = 0;
+	if (!stream) outbytes = unified::writer::write(args.out, mesh, args.fmt, args.opts);
+#ifdef WITH_HRY
+	else outbytes = unified::writer::write_stream(args.out, mesh, [&args] (const unified::reader::FaceHandler &f) { unified::reader::read_faces(args.in, f); }, args.fmt, args.opts);
+#endif
 
 	std::chrono::high_resolution_clock::time_point t3 = std::chrono::high_resolution_clock::now();
 	std::cout << "Writing output took " << std::chrono::duration_cast<std::chrono::milliseconds>(t3 - t2).count() << " ms." << std::endl;
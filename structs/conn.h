@@ -11,7 +11,10 @@
 
 #include "types.h"
 #include "faces.h"
+#include "utils/parallel.h"
 
+#include <algorithm>
+#include <atomic>
 #include <vector>
 #include <unordered_map>
 #include <limits>
@@ -69,15 +72,18 @@ inline ledgeidx_t ep(ledgeidx_t e, ledgeidx_t c)
 	return e == 0 ? c - 1 : e - 1;
 }
 
+// Half-edges are addressed either by fepairs or by their global index, the offset of their face plus the local index, which
+// packs a half-edge into 32 bits. The twins are stored as global indices.
 struct Conn {
 	struct edgeorg {
 		vtxidx_t org;
-		fepair twin;
+		edgeidx_t twin;
 	};
 	vtxidx_t mnum_vtx;
 	faceidx_t mnum_tri;
 	Faces &f;
 	std::vector<edgeorg> edges;
+	std::vector<faceidx_t> edgeface; // face of every edge, empty while all faces are triangles (like the offsets of Faces)
 
 	inline Conn(Faces &_f) : f(_f), mnum_vtx(0), mnum_tri(0)
 	{}
@@ -89,10 +95,23 @@ struct Conn {
 		edgeidx_t o = edges.size();
 		edges.resize(edges.size() + ne);
 		for (edgeidx_t i = 0; i < ne; ++i) {
-			edges[o + i].twin = fepair(idx, i);
+			edges[o + i].twin = o + i;
+		}
+		if (!f.offsets.empty()) {
+			for (edgeidx_t i = edgeface.size(); i < o; ++i) edgeface.push_back(i / 3);
+			edgeface.resize(o + ne, idx);
 		}
 		return idx;
 	}
+	// allocates n faces with ne edges in total, whose offsets (and faces of the edges) are set by the caller unless all of
+	// them are triangles
+	inline void resize(faceidx_t n, edgeidx_t ne)
+	{
+		f.resize(n, ne);
+		edges.resize(ne);
+		if (!f.offsets.empty()) edgeface.resize(ne);
+		else edgeface.clear();
+	}
 
 	inline void reserve(faceidx_t hint)
 	{
@@ -112,56 +131,119 @@ struct Conn {
 	{
 		return mnum_tri;
 	}
+	// The accessors take TRI = true for meshes of triangles only (see Faces::only_triangles()): the edges of face f are
+	// 3f, 3f + 1 and 3f + 2, so neither the offsets nor the number of edges are looked up.
+	template <bool TRI = false>
 	inline ledgeidx_t num_edges(faceidx_t fi) const
 	{
-		return f.num_edges(fi);
+		return TRI ? 3 : f.num_edges(fi);
 	}
 	inline faceidx_t face(fepair a) const
 	{
 		return a.f();
 	}
+	template <bool TRI = false>
 	inline edgeidx_t edge(fepair a) const
 	{
-		return f.off(a.f()) + a.e();
+		return (TRI ? 3 * a.f() : f.off(a.f())) + a.e();
 	}
 
-	inline void set_org(faceidx_t fi, ledgeidx_t v, vtxidx_t o)
+	// accessors of the global indices
+	template <bool TRI = false>
+	inline faceidx_t hface(edgeidx_t h) const
+	{
+		return TRI || edgeface.empty() ? h / 3 : edgeface[h];
+	}
+	template <bool TRI = false>
+	inline fepair fe(edgeidx_t h) const
+	{
+		faceidx_t fi = hface<TRI>(h);
+		return fepair(fi, h - (TRI ? 3 * fi : f.off(fi)));
+	}
+	template <bool TRI = false>
+	inline edgeidx_t hnext(edgeidx_t h) const
+	{
+		if (TRI) return h % 3 == 2 ? h - 2 : h + 1;
+		faceidx_t fi = hface(h);
+		edgeidx_t o = f.off(fi);
+		return h + 1 == o + f.num_edges(fi) ? o : h + 1;
+	}
+	template <bool TRI = false>
+	inline edgeidx_t hprev(edgeidx_t h) const
+	{
+		if (TRI) return h % 3 == 0 ? h + 2 : h - 1;
+		faceidx_t fi = hface(h);
+		edgeidx_t o = f.off(fi);
+		return h == o ? o + f.num_edges(fi) - 1 : h - 1;
+	}
+	inline edgeidx_t htwin(edgeidx_t h) const
+	{
+		return edges[h].twin;
+	}
+	inline vtxidx_t horg(edgeidx_t h) const
+	{
+		return edges[h].org;
+	}
+	template <bool TRI = false>
+	inline vtxidx_t hdest(edgeidx_t h) const
+	{
+		return horg(hnext<TRI>(h));
+	}
+	inline void hset_org(edgeidx_t h, vtxidx_t o)
 	{
-		edges[f.off(fi) + v].org = o;
+		edges[h].org = o;
 		mnum_vtx = std::max(mnum_vtx, o + 1);
 	}
+	inline void hmerge(edgeidx_t a, edgeidx_t b)
+	{
+		edges[a].twin = b;
+		edges[b].twin = a;
+	}
+
+	template <bool TRI = false>
+	inline void set_org(faceidx_t fi, ledgeidx_t v, vtxidx_t o)
+	{
+		hset_org(edge<TRI>(fepair(fi, v)), o);
+	}
+	template <bool TRI = false>
 	inline void set_org(fepair a, vtxidx_t o)
 	{
-		set_org(a.f(), a.e(), o);
+		set_org<TRI>(a.f(), a.e(), o);
 	}
+	template <bool TRI = false>
 	inline fepair enext(fepair a) const
 	{
-		return fepair(a.f(), en(a.e(), num_edges(a.f())));
+		return fepair(a.f(), en(a.e(), num_edges<TRI>(a.f())));
 	}
+	template <bool TRI = false>
 	inline fepair eprev(fepair a) const
 	{
-		return fepair(a.f(), ep(a.e(), num_edges(a.f())));
+		return fepair(a.f(), ep(a.e(), num_edges<TRI>(a.f())));
 	}
+	template <bool TRI = false>
 	inline fepair twin(fepair a) const
 	{
-		return edges[edge(a)].twin;
+		return fe<TRI>(edges[edge<TRI>(a)].twin);
 	}
+	template <bool TRI = false>
 	inline vtxidx_t org(faceidx_t fi, ledgeidx_t v) const
 	{
-		return edges[f.off(fi) + v].org;
+		return edges[edge<TRI>(fepair(fi, v))].org;
 	}
+	template <bool TRI = false>
 	inline vtxidx_t org(fepair a) const
 	{
-		return org(a.f(), a.e());
+		return org<TRI>(a.f(), a.e());
 	}
+	template <bool TRI = false>
 	inline vtxidx_t dest(fepair a) const
 	{
-		return org(enext(a));
+		return org<TRI>(enext<TRI>(a));
 	}
+	template <bool TRI = false>
 	inline void fmerge(fepair a, fepair b)
 	{
-		edges[edge(a)].twin = b;
-		edges[edge(b)].twin = a;
+		hmerge(edge<TRI>(a), edge<TRI>(b));
 	}
 	inline void splot(fepair a)
 	{
@@ -169,6 +251,10 @@ struct Conn {
 	}
 };
 
+// Matches the twins of the edges by their vertices. Without a known number of faces every edge looks up its opposite in a
+// hash map. After bulk(), finish() matches the edges in bulk instead: a counting sort (a radix sort with one digit) groups
+// them by their lower vertex, then every group is sorted by the other vertex. The edges of a pair of vertices are matched in
+// the order in which they were added, as the hash map does. The groups are matched in parallel.
 struct Builder {
 	struct pairhash {
 		template <typename T, typename U>
@@ -178,18 +264,19 @@ struct Builder {
 		}
 	};
 	typedef std::pair<vtxidx_t, vtxidx_t> edgemap_e;
-	typedef std::unordered_map<edgemap_e, fepair, pairhash> edgemap;
+	typedef std::unordered_map<edgemap_e, edgeidx_t, pairhash> edgemap;
 
 	edgemap em;
+	edgeidx_t first; // first edge which is matched by finish()
 	faceidx_t cur_f;
 	ledgeidx_t cur_c;
 	vtxidx_t last_vtx;
 	vtxidx_t start_vtx;
-	bool automerge;
+	bool automerge, sorted;
 
 	Conn &c;
 
-	inline Builder(Conn &_conn) : c(_conn), cur_f(std::numeric_limits<faceidx_t>::max()), automerge(true)
+	inline Builder(Conn &_conn) : c(_conn), cur_f(std::numeric_limits<faceidx_t>::max()), automerge(true), sorted(false)
 	{}
 
 	inline void reserve(faceidx_t hint)
@@ -197,16 +284,23 @@ struct Builder {
 		em.reserve(hint * 3);
 		c.reserve(hint);
 	}
+	// nf faces are going to be added, their twins are matched by finish()
+	inline void bulk(faceidx_t nf)
+	{
+		sorted = true;
+		first = c.edges.size();
+		c.reserve(nf);
+	}
 
 	inline void add_edge(vtxidx_t a, vtxidx_t b)
 	{
-		if (!automerge) return;
+		if (!automerge || sorted) return;
 
-		fepair p(cur_f, cur_c - 1);
+		edgeidx_t p = c.edge(fepair(cur_f, cur_c - 1));
 
 		edgemap::iterator twin = em.find(edgemap_e(b, a));
 		if (twin != em.end()) { // found a twin, merge
-			c.fmerge(twin->second, p);
+			c.hmerge(twin->second, p);
 			em.erase(twin);
 		} else {
 			em.insert(std::make_pair(edgemap_e(a, b), p));
@@ -231,7 +325,56 @@ struct Builder {
 		++cur_c;
 		last_vtx = vtx;
 	}
-};
 
+	inline void finish(unsigned int threads = 0)
+	{
+		if (!sorted) return;
+		sorted = false;
+		if (!automerge) return;
+
+		static const std::size_t BLOCK = 1 << 16;
+		static const edgeidx_t NONE = std::numeric_limits<edgeidx_t>::max();
+		vtxidx_t nv = c.num_vtx();
+		edgeidx_t ne = c.edges.size();
+		auto lo = [this] (edgeidx_t p) { return std::min(c.horg(p), c.hdest(p)); };
+
+		// pos[v + 1] counts the edges of v, after the prefix sum pos[v] is the start of v, after the scatter it is its end
+		std::vector<std::atomic<edgeidx_t>> pos(nv + 1);
+		std::vector<edgeidx_t> order(ne - first);
+		parallel::for_each((ne - first + BLOCK - 1) / BLOCK, threads, [&] (std::size_t b) {
+			for (edgeidx_t p = first + b * BLOCK; p < std::min<std::size_t>(ne, first + (b + 1) * BLOCK); ++p) ++pos[lo(p) + 1];
+		});
+		for (vtxidx_t v = 0; v < nv; ++v) pos[v + 1] += pos[v];
+		parallel::for_each((ne - first + BLOCK - 1) / BLOCK, threads, [&] (std::size_t b) {
+			for (edgeidx_t p = first + b * BLOCK; p < std::min<std::size_t>(ne, first + (b + 1) * BLOCK); ++p) order[pos[lo(p)]++] = p;
+		});
+
+		parallel::for_each((nv + BLOCK - 1) / BLOCK, threads, [&] (std::size_t b) {
+			std::vector<std::pair<vtxidx_t, edgeidx_t>> group; // other vertex and edge
+			for (vtxidx_t v = b * BLOCK; v < std::min<std::size_t>(nv, (b + 1) * BLOCK); ++v) {
+				group.clear();
+				for (edgeidx_t i = v == 0 ? 0 : pos[v - 1].load(); i < pos[v]; ++i) {
+					edgeidx_t p = order[i];
+					vtxidx_t o = c.horg(p);
+					group.push_back(std::make_pair(o == v ? c.hdest(p) : o, p));
+				}
+				std::sort(group.begin(), group.end());
+				for (std::size_t i = 0, j; i < group.size(); i = j) {
+					edgeidx_t open[2] = { NONE, NONE }; // unmatched edge from v and to v
+					for (j = i; j < group.size() && group[j].first == group[i].first; ++j) {
+						edgeidx_t p = group[j].second;
+						int d = c.horg(p) == v ? 0 : 1, o = group[j].first == v ? d : 1 - d;
+						if (open[o] != NONE) {
+							c.hmerge(open[o], p);
+							open[o] = NONE;
+						} else if (open[d] == NONE) {
+							open[d] = p;
+						}
+					}
+				}
+			}
+		});
+	}
+};
 }
 }
@@ -16,7 +16,8 @@
 namespace mesh {
 
 struct Faces {
-	std::vector<edgeidx_t> offsets;
+	std::vector<edgeidx_t> offsets; // first edge of every face and the number of edges, empty while all faces are triangles
+	faceidx_t nf;
 	std::vector<char> have_edges;
 	struct EdgeIterator {
 		const char *edges;
@@ -49,40 +50,55 @@ struct Faces {
 		}
 	};
 
-	Faces() : offsets(1, 0)
+	Faces() : nf(0)
 	{}
 
 	edgeidx_t size()
 	{
-		return offsets.size() - 1;
+		return nf;
 	}
 	void seen_edge(ledgeidx_t ne)
 	{
 		if (ne >= have_edges.size()) have_edges.resize(ne + 1, false);
 		have_edges[ne] = true;
 	}
+	// whether all faces are triangles, which lets the coders use the triangle specialization (see conn::Conn)
+	bool only_triangles() const
+	{
+		return have_edges.size() == 4 && have_edges[3] && !have_edges[0] && !have_edges[1] && !have_edges[2];
+	}
 	faceidx_t add(ledgeidx_t ne)
 	{
-		faceidx_t idx = size();
-		offsets.push_back(offsets.back() + ne);
+		if (ne != 3 && offsets.empty()) {
+			offsets.resize(nf + 1);
+			for (faceidx_t f = 0; f <= nf; ++f) offsets[f] = 3 * f;
+		}
+		if (!offsets.empty()) offsets.push_back(offsets.back() + ne);
 		seen_edge(ne);
-		return idx;
+		return nf++;
+	}
+	// allocates n faces with ne edges in total, whose offsets are set by the caller unless all of them are triangles
+	void resize(faceidx_t n, edgeidx_t ne)
+	{
+		nf = n;
+		if (ne == 3 * n) offsets.clear();
+		else offsets.resize(n + 1, 0);
 	}
 	edgeidx_t off(faceidx_t f) const
 	{
-		return offsets[f];
+		return offsets.empty() ? 3 * f : offsets[f];
 	}
 	ledgeidx_t num_edges(faceidx_t f) const
 	{
-		return offsets[f + 1] - offsets[f];
+		return offsets.empty() ? 3 : offsets[f + 1] - offsets[f];
 	}
 	edgeidx_t size_edge()
 	{
-		return offsets.back();
+		return offsets.empty() ? 3 * nf : offsets.back();
 	}
 	void reserve(faceidx_t hint)
 	{
-		offsets.reserve(hint);
+		if (!offsets.empty()) offsets.reserve(hint + 1);
 	}
 
 	EdgeIterator edge_begin()
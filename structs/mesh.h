@@ -50,6 +50,15 @@ struct Builder {
 	{
 		builder_conn.automerge = false;
 	}
+	// the number of faces is known up front; finish() has to be called after the last face
+	void bulk(faceidx_t nf)
+	{
+		builder_conn.bulk(nf);
+	}
+	void finish(unsigned int threads = 0)
+	{
+		builder_conn.finish(threads);
+	}
 
 	// Generic
 	vtxidx_t num_vtx()
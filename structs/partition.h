@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "mesh.h"
+#include "utils/parallel.h"
+
+namespace partition {
+
+static const std::size_t BLOCK = 1 << 16; // faces or vertices per task
+
+// The position of a vertex is the first attribute of its region with the POS interpretation. Vertices without positions
+// are placed on a line by their index.
+struct Positions {
+	mesh::Mesh &mesh;
+	std::vector<int> binding; // per vertex region, -1 for none
+
+	Positions(mesh::Mesh &_mesh) : mesh(_mesh), binding(_mesh.attrs.num_regs_vtx(), -1)
+	{
+		for (mesh::regidx_t r = 0; r < mesh.attrs.num_regs_vtx(); ++r) {
+			for (mesh::listidx_t a = 0; a < mesh.attrs.num_bindings_vtx_reg(r) && binding[r] == -1; ++a) {
+				if (mesh.attrs[mesh.attrs.binding_reg_vtxlist(r, a)].interps().has(mixing::POS)) binding[r] = a;
+			}
+		}
+	}
+
+	void get(mesh::vtxidx_t v, double *p)
+	{
+		p[0] = p[1] = p[2] = 0;
+		int a = v < mesh.attrs.num_vtx() ? binding[mesh.attrs.vtx2reg(v)] : -1;
+		if (a == -1) {
+			p[0] = v;
+			return;
+		}
+		mesh::attr::Attr &attr = mesh.attrs[mesh.attrs.binding_reg_vtxlist(mesh.attrs.vtx2reg(v), a)];
+		mixing::View e = attr[mesh.attrs.binding_vtx_attr(v, a)];
+		int off = attr.interps().off(mixing::POS), len = std::min(attr.interps().len(mixing::POS), 3);
+		for (int i = 0; i < len; ++i) p[i] = e.get<double>(off + i);
+	}
+};
+
+struct Centroid {
+	float c[3];
+	mesh::faceidx_t f;
+};
+
+inline void centroids(mesh::Mesh &mesh, std::vector<Centroid> &cent, unsigned int threads)
+{
+	Positions pos(mesh);
+	mesh::vtxidx_t nv = mesh.conn.num_vtx();
+	std::vector<float> vpos((std::size_t)nv * 3);
+	parallel::for_each((nv + BLOCK - 1) / BLOCK, threads, [&] (std::size_t b) {
+		double p[3];
+		for (mesh::vtxidx_t v = b * BLOCK; v < std::min<std::size_t>(nv, (b + 1) * BLOCK); ++v) {
+			pos.get(v, p);
+			std::copy(p, p + 3, &vpos[(std::size_t)v * 3]);
+		}
+	});
+
+	mesh::faceidx_t nf = mesh.num_face();
+	cent.resize(nf);
+	parallel::for_each((nf + BLOCK - 1) / BLOCK, threads, [&] (std::size_t b) {
+		for (mesh::faceidx_t f = b * BLOCK; f < std::min<std::size_t>(nf, (b + 1) * BLOCK); ++f) {
+			double c[3] = { 0, 0, 0 };
+			mesh::ledgeidx_t ne = mesh.conn.num_edges(f);
+			for (mesh::ledgeidx_t e = 0; e < ne; ++e) {
+				const float *p = &vpos[(std::size_t)mesh.conn.org(f, e) * 3];
+				for (int i = 0; i < 3; ++i) c[i] += p[i];
+			}
+			for (int i = 0; i < 3; ++i) cent[f].c[i] = c[i] / ne;
+			cent[f].f = f;
+		}
+	});
+}
+
+// faces cent[begin, end) which are split into n clusters, starting with the given one
+struct Range {
+	mesh::faceidx_t begin, end;
+	uint32_t n, first;
+};
+
+// Recursive bisection of the face centroids: a range of faces is split at the median of the longest axis of its bounding
+// box into two ranges, whose sizes are proportional to the number of clusters they are split into. The ranges of a level
+// are split in parallel. leaves receives the range of every cluster.
+inline void bisect(std::vector<Centroid> &cent, uint32_t n, std::vector<uint32_t> &part, std::vector<Range> &leaves, unsigned int threads)
+{
+	leaves.resize(n);
+	std::vector<Range> level(1, Range{ 0, (mesh::faceidx_t)cent.size(), n, 0 });
+	while (!level.empty()) {
+		std::vector<Range> next(level.size() * 2, Range{ 0, 0, 0, 0 });
+		parallel::for_each(level.size(), threads, [&] (std::size_t i) {
+			Range r = level[i];
+			if (r.n == 1) {
+				for (mesh::faceidx_t j = r.begin; j < r.end; ++j) part[cent[j].f] = r.first;
+				leaves[r.first] = r;
+				return;
+			}
+			float min[3], max[3];
+			std::fill(min, min + 3, std::numeric_limits<float>::max());
+			std::fill(max, max + 3, std::numeric_limits<float>::lowest());
+			for (mesh::faceidx_t j = r.begin; j < r.end; ++j) {
+				for (int k = 0; k < 3; ++k) {
+					min[k] = std::min(min[k], cent[j].c[k]);
+					max[k] = std::max(max[k], cent[j].c[k]);
+				}
+			}
+			int axis = 0;
+			for (int k = 1; k < 3; ++k) {
+				if (max[k] - min[k] > max[axis] - min[axis]) axis = k;
+			}
+			uint32_t nl = r.n / 2;
+			mesh::faceidx_t mid = r.begin + (uint64_t)(r.end - r.begin) * nl / r.n;
+			std::nth_element(cent.begin() + r.begin, cent.begin() + mid, cent.begin() + r.end, [axis] (const Centroid &a, const Centroid &b) { return a.c[axis] < b.c[axis]; });
+			next[i * 2] = Range{ r.begin, mid, nl, r.first };
+			next[i * 2 + 1] = Range{ mid, r.end, r.n - nl, r.first + nl };
+		});
+		next.erase(std::remove_if(next.begin(), next.end(), [] (const Range &r) { return r.n == 0; }), next.end());
+		level.swap(next);
+	}
+}
+
+// Region growing over the twins within the clusters, which splits every cluster into connected pieces. A piece which is not
+// the largest one of its cluster moves to the cluster of the largest piece it touches, if that one is larger. This joins
+// small connected components which have been cut by a bisection. The clusters are processed in parallel.
+inline void refine(mesh::Mesh &mesh, const std::vector<Centroid> &cent, const std::vector<Range> &leaves, std::vector<uint32_t> &part, unsigned int threads)
+{
+	uint32_t n = leaves.size();
+	std::vector<mesh::faceidx_t> size(cent.size(), 0); // size of the piece of every face
+	std::vector<std::vector<mesh::faceidx_t>> order(n), starts(n); // faces of a cluster grouped by pieces
+	parallel::for_each(n, threads, [&] (std::size_t c) {
+		std::vector<mesh::faceidx_t> &q = order[c], &st = starts[c];
+		q.reserve(leaves[c].end - leaves[c].begin);
+		for (mesh::faceidx_t j = leaves[c].begin; j < leaves[c].end; ++j) {
+			if (size[cent[j].f] != 0) continue;
+			st.push_back(q.size());
+			size[cent[j].f] = 1;
+			q.push_back(cent[j].f);
+			for (std::size_t h = st.back(); h < q.size(); ++h) {
+				for (mesh::ledgeidx_t e = 0; e < mesh.conn.num_edges(q[h]); ++e) {
+					mesh::faceidx_t t = mesh.conn.twin(mesh::conn::fepair(q[h], e)).f();
+					if (part[t] != c || size[t] != 0) continue;
+					size[t] = 1;
+					q.push_back(t);
+				}
+			}
+			for (std::size_t h = st.back(); h < q.size(); ++h) size[q[h]] = q.size() - st.back();
+		}
+		st.push_back(q.size());
+	});
+
+	std::vector<std::vector<std::pair<std::size_t, uint32_t>>> moves(n); // piece and its new cluster
+	parallel::for_each(n, threads, [&] (std::size_t c) {
+		const std::vector<mesh::faceidx_t> &q = order[c], &st = starts[c];
+		std::size_t largest = 0;
+		for (std::size_t p = 1; p + 1 < st.size(); ++p) {
+			if (st[p + 1] - st[p] > st[largest + 1] - st[largest]) largest = p;
+		}
+		for (std::size_t p = 0; p + 1 < st.size(); ++p) {
+			if (p == largest) continue;
+			uint32_t best = c;
+			mesh::faceidx_t bestsize = st[p + 1] - st[p];
+			for (std::size_t h = st[p]; h < st[p + 1]; ++h) {
+				for (mesh::ledgeidx_t e = 0; e < mesh.conn.num_edges(q[h]); ++e) {
+					mesh::faceidx_t t = mesh.conn.twin(mesh::conn::fepair(q[h], e)).f();
+					if (part[t] == c) continue;
+					if (size[t] > bestsize || (size[t] == bestsize && part[t] < best)) {
+						best = part[t];
+						bestsize = size[t];
+					}
+				}
+			}
+			if (best != c) moves[c].push_back(std::make_pair(p, best));
+		}
+	});
+	parallel::for_each(n, threads, [&] (std::size_t c) {
+		for (std::size_t i = 0; i < moves[c].size(); ++i) {
+			std::size_t p = moves[c][i].first;
+			for (std::size_t h = starts[c][p]; h < starts[c][p + 1]; ++h) part[order[c][h]] = moves[c][i].second;
+		}
+	});
+}
+
+// Splits the faces into n balanced clusters with small borders: a recursive bisection of the face centroids, which is refined
+// by region growing. part receives the cluster of every face; returns the number of clusters, which are never empty.
+inline uint32_t partition(mesh::Mesh &mesh, uint32_t n, std::vector<uint32_t> &part, unsigned int threads = 0)
+{
+	mesh::faceidx_t nf = mesh.num_face();
+	part.assign(nf, 0);
+	n = std::min(n, nf);
+	if (n <= 1) return n;
+
+	std::vector<Centroid> cent;
+	std::vector<Range> leaves;
+	centroids(mesh, cent, threads);
+	bisect(cent, n, part, leaves, threads);
+	refine(mesh, cent, leaves, part, threads);
+	return n;
+}
+
+}
@@ -27,13 +27,22 @@ struct Quant {
 	{}
 };
 
-inline void set_bounds(mesh::attr::Attr &attr)
+inline void reset_bounds(mesh::attr::Attr &attr)
 {
 	attr.min().set([] (auto dummy) { return std::numeric_limits<decltype(dummy)>::max(); }, attr.min());
 	attr.max().set([] (auto dummy) { return std::numeric_limits<decltype(dummy)>::min(); }, attr.max());
+}
+// extends the bounds of the list by an entry, which does not need to be stored in the list
+inline void extend_bounds(mesh::attr::Attr &attr, mixing::View elem)
+{
+	attr.min().set([] (auto cur, auto elem) { return elem < cur ? elem : cur; }, attr.min(), elem);
+	attr.max().set([] (auto cur, auto elem) { return elem > cur ? elem : cur; }, attr.max(), elem);
+}
+inline void set_bounds(mesh::attr::Attr &attr)
+{
+	reset_bounds(attr);
 	for (mesh::attridx_t i = 0; i < attr.size(); ++i) {
-		attr.min().set([] (auto cur, auto elem) { return elem < cur ? elem : cur; }, attr.min(), attr[i]);
-		attr.max().set([] (auto cur, auto elem) { return elem > cur ? elem : cur; }, attr.max(), attr[i]);
+		extend_bounds(attr, attr[i]);
 	}
 }
 inline void set_bounds(mesh::attr::Attrs &attrs)
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+// Microbenchmarks of the building blocks of the coders:
+//   stat: the statistics modules of the byte models, alone and with every backend of the entropy coder
+//   cbm: the traversal of the cut-border machine on a triangulated torus, whose symbols are kept in memory instead of coded
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+
+#include "arith/coder.h"
+#include "arith/range.h"
+#include "arith/rans.h"
+#include "arith/stat_adaptive.h"
+#include "arith/stat_block.h"
+#include "cbm/encoder.h"
+#include "cbm/decoder.h"
+#include "utils/args.h"
+
+struct Args {
+	std::string mode;
+	uint32_t n, torus, runs;
+
+	Args(int argc, const char **argv) : n(20000000), torus(1000), runs(5)
+	{
+		args::parser args(argc, argv, "Harry microbenchmarks");
+		const int ARG_MOD = args.add_nonopt("MODE"); args.range(1, 1);
+		const int ARG_NUM = args.add_opt('n', "symbols", "Number of symbols for stat (default: 20M)");
+		const int ARG_TOR = args.add_opt('t', "torus",   "Rings and segments of the torus for cbm (default: 1000)");
+		const int ARG_RUN = args.add_opt('r', "runs",    "Runs for cbm, of which the fastest is reported (default: 5)");
+
+		for (int arg = args.next(); arg != args::parser::end; arg = args.next()) {
+			if (arg == ARG_MOD)      mode  = args.val<std::string>();
+			else if (arg == ARG_NUM) n     = args.val<uint32_t>();
+			else if (arg == ARG_TOR) torus = args.val<uint32_t>();
+			else if (arg == ARG_RUN) runs  = args.val<uint32_t>();
+		}
+	}
+};
+
+typedef std::chrono::high_resolution_clock Clock;
+
+inline double seconds(Clock::time_point t0)
+{
+	return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+// all 256 symbols start with a count of 1, like in ModelMult
+template <typename S>
+void init(S &stat)
+{
+	for (uint32_t i = 0; i < 256; ++i) stat.init(i);
+}
+
+// ns per symbol of the calls of the encoder (range, total, inc) and of the decoder (total, symbol, inc)
+template <typename S>
+void bench_stat(const std::vector<uint8_t> &src, const char *name)
+{
+	uint64_t l, h, acc = 0;
+	S enc(256), dec(256);
+	init(enc);
+	init(dec);
+
+	Clock::time_point t0 = Clock::now();
+	for (uint8_t s : src) {
+		enc.range(s, l, h);
+		acc += l + enc.total();
+		enc.inc(s);
+	}
+	double te = seconds(t0);
+
+	t0 = Clock::now();
+	for (uint8_t s : src) {
+		dec.range(s, l, h); // the target of a real decoder is somewhere in the range of the symbol
+		acc += dec.total();
+		if (dec.symbol(l + (h - l) / 2, l, h) != s) throw std::runtime_error("Symbol lookup failed");
+		dec.inc(s);
+	}
+	double td = seconds(t0);
+
+	std::cout << "  " << name << ": range+total+inc " << te * 1e9 / src.size() << " ns, symbol+inc " << td * 1e9 / src.size() << " ns (" << acc % 2 << ")" << std::endl;
+}
+
+// MB/s of coding the symbols with one statistics module
+template <arith::Backend B, typename S>
+void bench_coder(const std::vector<uint8_t> &src, const char *name)
+{
+	std::vector<uint8_t> buf, dst(src.size());
+
+	Clock::time_point t0 = Clock::now();
+	{
+		S stat(256);
+		init(stat);
+		arith::Encoder<uint64_t, B> coder(buf);
+		for (uint8_t s : src) {
+			coder(stat, s);
+			stat.inc(s);
+		}
+		coder.flush();
+	}
+	double te = seconds(t0);
+
+	t0 = Clock::now();
+	{
+		S stat(256);
+		init(stat);
+		arith::Decoder<uint64_t, B> coder(buf.data(), buf.data() + buf.size());
+		for (uint8_t &s : dst) {
+			s = coder(stat);
+			stat.inc(s);
+		}
+	}
+	double td = seconds(t0);
+	if (dst != src) throw std::runtime_error("Decoded symbols differ");
+
+	std::cout << "  " << name << ": " << buf.size() << " bytes, enc " << src.size() / te / 1e6 << " MB/s, dec " << src.size() / td / 1e6 << " MB/s" << std::endl;
+}
+
+void stat(uint32_t n)
+{
+	typedef arith::AdaptiveStatisticsModule<> Fenwick;
+	typedef arith::BlockStatisticsModule<> Block;
+
+	std::mt19937 rng(1);
+	std::vector<uint8_t> geom(n), unif(n);
+	std::geometric_distribution<int> g(0.15);
+	std::uniform_int_distribution<int> u(0, 255);
+	for (uint32_t i = 0; i < n; ++i) {
+		geom[i] = std::min(g(rng), 255);
+		unif[i] = u(rng);
+	}
+
+	std::cout << "Statistics, uniform symbols:" << std::endl;
+	bench_stat<Fenwick>(unif, "fenwick");
+	bench_stat<Block>(unif, "block  ");
+	std::cout << "Statistics, geometric symbols:" << std::endl;
+	bench_stat<Fenwick>(geom, "fenwick");
+	bench_stat<Block>(geom, "block  ");
+
+	std::cout << "Coder and statistics, geometric symbols:" << std::endl;
+	bench_coder<arith::ARITH, Fenwick>(geom, "arith fenwick");
+	bench_coder<arith::ARITH, Block>(geom, "arith block  ");
+	bench_coder<arith::RANGE, Fenwick>(geom, "range fenwick");
+	bench_coder<arith::RANGE, Block>(geom, "range block  ");
+	bench_coder<arith::RANS, Fenwick>(geom, "rans fenwick ");
+	bench_coder<arith::RANS, Block>(geom, "rans block   ");
+}
+
+// Triangulated torus of n x n vertices for the encoder; the half-edge 3 * f + e starts at corner e of face f.
+struct TorusHandle {
+	typedef int Edge;
+	static const bool tri = true;
+
+	int n;
+	std::vector<int> orgs, twins;
+	std::vector<bool> remaining;
+	int cursor, num_remaining;
+
+	TorusHandle(int _n) : n(_n), cursor(0), num_remaining(2 * _n * _n)
+	{
+		orgs.reserve(6 * n * n);
+		for (int i = 0; i < n; ++i) {
+			for (int j = 0; j < n; ++j) {
+				int a = i * n + j, b = (i + 1) % n * n + j, c = (i + 1) % n * n + (j + 1) % n, d = i * n + (j + 1) % n;
+				int quad[6] = { a, b, c, a, c, d };
+				orgs.insert(orgs.end(), quad, quad + 6);
+			}
+		}
+
+		// the twin of a half-edge runs from the next origin to its origin
+		std::vector<std::pair<uint64_t, int>> keys(orgs.size());
+		for (std::size_t e = 0; e < orgs.size(); ++e) keys[e] = std::make_pair(key(orgs[e], org(next(e))), e);
+		std::sort(keys.begin(), keys.end());
+		twins.resize(orgs.size());
+		for (std::size_t e = 0; e < orgs.size(); ++e) {
+			uint64_t k = key(org(next(e)), orgs[e]);
+			twins[e] = std::lower_bound(keys.begin(), keys.end(), std::make_pair(k, 0))->second;
+		}
+		remaining.assign(2 * n * n, true);
+	}
+
+	uint64_t key(int a, int b)
+	{
+		return (uint64_t)a * n * n + b;
+	}
+
+	int num_vtx()
+	{
+		return n * n;
+	}
+	Edge choose_tri()
+	{
+		while (!remaining[cursor]) ++cursor;
+		remaining[cursor] = false;
+		--num_remaining;
+		return cursor * 3;
+	}
+	Edge choose_twin(Edge e, bool &success)
+	{
+		Edge a = twins[e];
+		success = a != e && remaining[face(a)];
+		if (!success) return Edge();
+		remaining[face(a)] = false;
+		--num_remaining;
+		return a;
+	}
+	bool empty()
+	{
+		return num_remaining == 0;
+	}
+	int org(Edge e)
+	{
+		return orgs[e];
+	}
+	Edge next(Edge e)
+	{
+		return e % 3 == 2 ? e - 2 : e + 1;
+	}
+	Edge twin(Edge e)
+	{
+		return twins[e];
+	}
+	void merge(Edge a, Edge b)
+	{
+		twins[a] = b;
+		twins[b] = a;
+	}
+	void split(Edge e)
+	{
+		twins[e] = e;
+	}
+	void link(Edge, Edge)
+	{}
+	bool border(Edge e)
+	{
+		return twins[e] == e;
+	}
+	int num_edges(int)
+	{
+		return 3;
+	}
+	int face(Edge e)
+	{
+		return e / 3;
+	}
+	int edge(Edge e)
+	{
+		return e % 3;
+	}
+};
+
+// the faces which are rebuilt by the decoder
+struct TriangleHandle {
+	typedef int Edge;
+	static const bool tri = true;
+
+	int nv;
+	std::vector<int> orgs, twins;
+
+	TriangleHandle(int _nv) : nv(_nv)
+	{}
+
+	int num_vtx()
+	{
+		return nv;
+	}
+	int add_face(int)
+	{
+		orgs.resize(orgs.size() + 3);
+		twins.resize(orgs.size());
+		return orgs.size() / 3 - 1;
+	}
+	Edge edge(int f)
+	{
+		return f * 3;
+	}
+	Edge next(Edge e)
+	{
+		return e % 3 == 2 ? e - 2 : e + 1;
+	}
+	void set_org(Edge e, int v)
+	{
+		orgs[e] = v;
+	}
+	void merge(Edge a, Edge b)
+	{
+		twins[a] = b;
+		twins[b] = a;
+	}
+};
+
+// The symbols of the cut-border machine in memory, in the order of io::writer, which replace the entropy coder.
+struct Symbols {
+	std::vector<int> syms;
+	std::size_t pos;
+
+	Symbols() : pos(0)
+	{}
+
+	void order(int)
+	{}
+
+	void initial(int ntri) { put(cbm::INIT); numtri(ntri); }
+	void tri100(int ntri, int v0) { put(cbm::TRI100); put(v0); numtri(ntri); }
+	void tri010(int ntri, int v0) { put(cbm::TRI010); put(v0); numtri(ntri); }
+	void tri001(int ntri, int v0) { put(cbm::TRI001); put(v0); numtri(ntri); }
+	void tri110(int ntri, int v0, int v1) { put(cbm::TRI110); put(v0); put(v1); numtri(ntri); }
+	void tri101(int ntri, int v0, int v1) { put(cbm::TRI101); put(v0); put(v1); numtri(ntri); }
+	void tri011(int ntri, int v0, int v1) { put(cbm::TRI011); put(v0); put(v1); numtri(ntri); }
+	void tri111(int ntri, int v0, int v1, int v2) { put(cbm::TRI111); put(v0); put(v1); put(v2); numtri(ntri); }
+	void end() { put(cbm::EOM); }
+	void border(cbm::OP bop = cbm::BORDER) { put(bop); }
+	void newvertex(int ntri) { put(cbm::NEWVTX); numtri(ntri); }
+	void connectforward(int ntri) { put(cbm::CONNFWD); numtri(ntri); }
+	void connectbackward(int ntri) { put(cbm::CONNBWD); numtri(ntri); }
+	void splitcutborder(int ntri, int i) { put(cbm::SPLIT); put(i); numtri(ntri); }
+	void cutborderunion(int ntri, int i, int p) { put(cbm::UNION); put(i); put(p); numtri(ntri); }
+	void nm(int ntri, int v) { put(cbm::NM); put(v); numtri(ntri); }
+
+	cbm::INITOP iop() { return (cbm::INITOP)get(); }
+	cbm::OP op() { return (cbm::OP)get(); }
+	int elem() { return get(); }
+	int part() { return get(); }
+	int vertid() { return get(); }
+	int numtri() { return get(); }
+
+private:
+	void put(int s)
+	{
+		syms.push_back(s);
+	}
+	void numtri(int n)
+	{
+		if (n != 0) put(n);
+	}
+	int get()
+	{
+		return syms[pos++];
+	}
+};
+
+struct NoAttrs {
+	void vtx(int, int)
+	{}
+	void face(int, int)
+	{}
+	void flush()
+	{}
+};
+
+void cbm_torus(uint32_t n, uint32_t runs)
+{
+	double te = 0, td = 0;
+	std::size_t nsyms = 0;
+	for (uint32_t r = 0; r < runs; ++r) {
+		TorusHandle enc(n);
+		Symbols syms;
+		NoAttrs attrs;
+		Clock::time_point t0 = Clock::now();
+		cbm::encode<TorusHandle, Symbols, NoAttrs, int, int>(enc, syms, attrs);
+		double t = seconds(t0);
+		te = r == 0 ? t : std::min(te, t);
+
+		TriangleHandle dec(n * n);
+		t0 = Clock::now();
+		cbm::decode<TriangleHandle, Symbols, NoAttrs, int, int>(dec, syms, attrs);
+		t = seconds(t0);
+		td = r == 0 ? t : std::min(td, t);
+
+		if (dec.orgs.size() != enc.orgs.size() || *std::max_element(dec.orgs.begin(), dec.orgs.end()) != (int)(n * n) - 1) throw std::runtime_error("Decoded torus differs");
+		nsyms = syms.syms.size();
+	}
+	std::cout << "Torus " << n << "x" << n << ": " << 2 * n * n << " triangles, " << nsyms << " symbols, enc " << te * 1e3 << " ms, dec " << td * 1e3 << " ms (fastest of " << runs << ")" << std::endl;
+}
+
+int main(int argc, const char **argv)
+{
+	Args args(argc, argv);
+
+	if (args.mode == "stat") stat(args.n);
+	else if (args.mode == "cbm") cbm_torus(args.torus, args.runs);
+	else throw std::runtime_error("Unknown benchmark: " + args.mode);
+
+	return EXIT_SUCCESS;
+}
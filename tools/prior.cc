@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+// Trains a prior for the HRY models on a corpus of meshes and writes it as a header for formats/hry/priors/.
+// Every mesh has the same weight, therefore the tables of each mesh are normalized before they are summed up.
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <cstdlib>
+
+#include "formats/unified_reader.h"
+#include "formats/hry/writer.h"
+#include "formats/hry/prior.h"
+#include "structs/mesh.h"
+#include "structs/quant.h"
+#include "utils/args.h"
+
+struct Args {
+	std::string out, name;
+	std::vector<std::string> in;
+	int quant;
+
+	Args(int argc, const char **argv) : name("generic"), quant(0)
+	{
+		args::parser args(argc, argv, "Harry prior training");
+		const int ARG_OUT = args.add_nonopt("OUTPUT");
+		const int ARG_IN  = args.add_nonopt("INPUT"); args.range(2);
+		const int ARG_NAM = args.add_opt('n', "name",  "Name of the prior (C++ identifier)");
+		const int ARG_QUA = args.add_opt('q', "quant", "Quantization bits for all attributes");
+
+		for (int arg = args.next(); arg != args::parser::end; arg = args.next()) {
+			if (arg == ARG_OUT)      out   = args.val<std::string>();
+			else if (arg == ARG_IN)  in.push_back(args.val<std::string>());
+			else if (arg == ARG_NAM) name  = args.val<std::string>();
+			else if (arg == ARG_QUA) quant = args.val<int>();
+		}
+	}
+};
+
+// maps the summed up frequencies onto 2^PRIOR_BITS, every seen symbol gets at least 1 like in StaticStatisticsModule
+void quantize(const std::vector<double> &p, std::vector<uint32_t> &f)
+{
+	const uint32_t total = 1 << hry::PRIOR_BITS;
+	int nz = 0, maxs = 0;
+	double sum = 0;
+	for (std::size_t i = 0; i < p.size(); ++i) {
+		if (p[i] != 0) ++nz;
+		if (p[i] > p[maxs]) maxs = i;
+		sum += p[i];
+	}
+	f.assign(p.size(), 0);
+	if (sum == 0) return;
+	uint32_t acc = 0;
+	for (std::size_t i = 0; i < p.size(); ++i) {
+		if (p[i] != 0) f[i] = 1 + (uint32_t)(p[i] * (total - nz) / sum);
+		acc += f[i];
+	}
+	f[maxs] += total - acc;
+}
+
+int main(int argc, const char **argv)
+{
+	Args args(argc, argv);
+
+	std::vector<std::vector<double>> acc(hry::PRIOR_NUM, std::vector<double>(hry::PRIOR_SYMS, 0));
+	for (std::size_t m = 0; m < args.in.size(); ++m) {
+		std::cout << "Counting " << args.in[m] << "..." << std::endl;
+		mesh::Mesh mesh;
+		unified::reader::read(args.in[m], mesh);
+		if (args.quant != 0) {
+			std::vector<quant::Quant> quant;
+			for (mesh::listidx_t l = 0; l < mesh.attrs.size(); ++l) {
+				for (int o = 0; o < mesh.attrs[l].fmt().size(); ++o) {
+					if (args.quant <= mesh.attrs[l].fmt().bytes(o) * 8) quant.push_back(quant::Quant(l, o, args.quant));
+				}
+			}
+			quant::requant(mesh.attrs, quant, false);
+		}
+
+		std::vector<std::vector<uint64_t>> counts;
+		hry::writer::count_prior(mesh, counts);
+		for (int t = 0; t < hry::PRIOR_NUM; ++t) {
+			uint64_t sum = 0;
+			for (int i = 0; i < hry::PRIOR_SYMS; ++i) sum += counts[t][i];
+			if (sum == 0) continue;
+			for (int i = 0; i < hry::PRIOR_SYMS; ++i) acc[t][i] += (double)counts[t][i] / sum;
+		}
+	}
+
+	std::ofstream os(args.out);
+	os << "/*\n * Copyright (C) 2017, Max von Buelow\n * TU Darmstadt - Graphics, Capture and Massively Parallel Computing\n * All rights reserved.\n *\n"
+	      " * This software may be modified and distributed under the terms\n * of the BSD 3-Clause license. See the LICENSE.txt file for details.\n */\n\n";
+	os << "// Prior \"" << args.name << "\", generated by harry-prior from " << args.in.size() << " meshes";
+	if (args.quant != 0) os << " with " << args.quant << " bit quantization";
+	os << "\n\n#pragma once\n\nnamespace hry {\n\n";
+	os << "inline const uint16_t (*prior_" << args.name << "())[PRIOR_SYMS]\n{\n";
+	os << "\tstatic const uint16_t tables[PRIOR_NUM][PRIOR_SYMS] = {\n";
+	for (int t = 0; t < hry::PRIOR_NUM; ++t) {
+		std::vector<uint32_t> f;
+		quantize(acc[t], f);
+		os << "\t\t{";
+		for (int i = 0; i < hry::PRIOR_SYMS; ++i) {
+			os << (i % 32 == 0 ? "\n\t\t\t" : " ") << f[i] << ",";
+		}
+		os << "\n\t\t},\n";
+	}
+	os << "\t};\n\treturn tables;\n}\n\n}\n";
+	if (!os) throw std::runtime_error("Could not write " + args.out);
+
+	return EXIT_SUCCESS;
+}
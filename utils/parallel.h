@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2017, Max von Buelow
+ * TU Darmstadt - Graphics, Capture and Massively Parallel Computing
+ * All rights reserved.
+ *
+ * This software may be modified and distributed under the terms
+ * of the BSD 3-Clause license. See the LICENSE.txt file for details.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// number of worker threads for a request of n threads (0 stands for all cores)
+inline unsigned int num_threads(unsigned int n)
+{
+	if (n != 0) return n;
+	n = std::thread::hardware_concurrency();
+	return n == 0 ? 1 : n;
+}
+
+// Calls f(i) for all i in [0, n) on up to the given number of threads. The items are handed out one by one, so they do not
+// need to be balanced. The first exception thrown by f is rethrown after all threads have finished.
+template <typename F>
+void for_each(std::size_t n, unsigned int threads, F f)
+{
+	threads = std::min<std::size_t>(num_threads(threads), n);
+	if (threads <= 1) {
+		for (std::size_t i = 0; i < n; ++i) f(i);
+		return;
+	}
+
+	std::atomic<std::size_t> next(0);
+	std::atomic<bool> failed(false);
+	std::exception_ptr error;
+	auto worker = [&] {
+		for (std::size_t i = next++; i < n && !failed; i = next++) {
+			try {
+				f(i);
+			} catch (...) {
+				if (!failed.exchange(true)) error = std::current_exception();
+			}
+		}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned int t = 1; t < threads; ++t) pool.emplace_back(worker);
+	worker();
+	for (std::thread &t : pool) t.join();
+	if (error) std::rethrow_exception(error);
+}
+
+}